@@ -0,0 +1,222 @@
+#include "batchrunner.h"
+#include "exceptions.h"
+#include "gamemodel.h"
+#include "nullgraphicsadapter.h"
+#include "replay.h"
+#include "view.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+namespace marengo {
+namespace amaze {
+
+namespace {
+
+bool isNumber(const std::string& s)
+{
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char c) {
+        return std::isdigit(c);
+    });
+}
+
+BatchResult runJob(const BatchJob& job, const BatchSettings& settings)
+{
+    BatchResult result;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        NullGraphicsAdapter graphicsAdapter(settings.screenWidth, settings.screenHeight);
+        int gameLevel = job.gameLevel;
+        std::string levelFile = job.levelFile;
+        uint32_t seed = job.seed;
+        std::optional<Replay> replay;
+        if (!job.replayFile.empty()) {
+            replay = loadReplay(job.replayFile);
+            gameLevel = replay->gameLevel;
+            levelFile = replay->levelFile;
+            seed = replay->seed;
+        } else if (!job.inputScript.empty()) {
+            graphicsAdapter.setInputScript(loadInputScript(job.inputScript));
+        }
+
+        GameModel gameModel(settings.dataDir);
+        gameModel.setContinuousCollision(settings.continuousCollision);
+        gameModel.setDistanceFieldCacheDirectory(settings.distanceFieldCache);
+        gameModel.setRandomSeed(seed);
+        View view(gameModel, graphicsAdapter);
+        Controller controller(gameModel, view, graphicsAdapter);
+        controller.setTickRate(settings.tickRate);
+        uint64_t frames = job.frames;
+        if (frames == 0 && !replay) {
+            frames = settings.defaultFrames;
+        }
+        controller.setFrameLimit(frames);
+        if (replay) {
+            controller.playReplay(std::move(*replay));
+        }
+        controller.mainLoop(gameLevel, levelFile);
+        result.outcome = controller.outcome();
+        result.timings = controller.phaseTimings();
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+void addTimings(PhaseTimings& total, const PhaseTimings& timings)
+{
+    total.levelLoad += timings.levelLoad;
+    total.schedule += timings.schedule;
+    total.input += timings.input;
+    total.simulation += timings.simulation;
+    total.collisions += timings.collisions;
+    total.view += timings.view;
+    total.redraw += timings.redraw;
+    total.steps += timings.steps;
+    total.frames += timings.frames;
+}
+
+} // namespace
+
+std::vector<BatchJob> loadBatchJobs(const std::string& fileName)
+{
+    std::ifstream ifs(fileName);
+    if (!ifs) {
+        THROWUP(AmazeRuntimeException, std::format("Could not open batch file {}", fileName));
+    }
+    std::vector<BatchJob> jobs;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(ifs, line)) {
+        ++lineNumber;
+        std::istringstream iss(line);
+        std::string level;
+        if (!(iss >> level) || level[0] == '#') {
+            continue;
+        }
+        BatchJob job;
+        if (isNumber(level)) {
+            job.gameLevel = std::stoi(level);
+        } else {
+            job.levelFile = level;
+        }
+        std::string input;
+        if (iss >> input && input != "-") {
+            if (input.starts_with("replay:")) {
+                job.replayFile = input.substr(7);
+            } else if (input.starts_with("script:")) {
+                job.inputScript = input.substr(7);
+            } else {
+                THROWUP(
+                    AmazeRuntimeException,
+                    std::format("Bad input in {} line {}", fileName, lineNumber));
+            }
+        }
+        std::string seed;
+        std::string frames;
+        iss >> seed >> frames;
+        if ((!seed.empty() && !isNumber(seed)) || (!frames.empty() && !isNumber(frames))) {
+            THROWUP(
+                AmazeRuntimeException,
+                std::format("Bad seed or frame count in {} line {}", fileName, lineNumber));
+        }
+        if (!seed.empty()) {
+            job.seed = static_cast<uint32_t>(std::stoul(seed));
+        }
+        if (!frames.empty()) {
+            job.frames = std::stoull(frames);
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs, const BatchSettings& settings)
+{
+    std::vector<BatchResult> results(jobs.size());
+    unsigned threadCount = settings.threads;
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, jobs.size()));
+
+    // Each thread takes the next job until there are none left. Jobs share
+    // nothing, so no other synchronisation is needed.
+    std::atomic<size_t> nextJob { 0 };
+    std::vector<std::thread> threads;
+    for (unsigned n = 0; n < threadCount; ++n) {
+        threads.emplace_back([&]() {
+            for (size_t job = nextJob++; job < jobs.size(); job = nextJob++) {
+                results[job] = runJob(jobs[job], settings);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+
+void printBatchReport(
+    const std::vector<BatchJob>& jobs,
+    const std::vector<BatchResult>& results,
+    std::chrono::nanoseconds elapsed)
+{
+    using namespace std::chrono;
+    PhaseTimings total;
+    nanoseconds busy {};
+    unsigned failed = 0;
+    unsigned levelsCompleted = 0;
+    unsigned shipsLost = 0;
+    for (size_t n = 0; n < jobs.size(); ++n) {
+        const BatchJob& job = jobs[n];
+        const BatchResult& result = results[n];
+        std::string level = job.replayFile.empty()
+            ? (job.levelFile.empty() ? std::to_string(job.gameLevel) : job.levelFile)
+            : job.replayFile;
+        if (!result.error.empty()) {
+            ++failed;
+            std::cout << std::format("{:>4} {:<32} FAILED: {}\n", n + 1, level, result.error);
+            continue;
+        }
+        addTimings(total, result.timings);
+        busy += result.elapsed;
+        levelsCompleted += result.outcome.levelsCompleted;
+        shipsLost += result.outcome.shipsLost;
+        std::cout << std::format(
+            "{:>4} {:<32} {} completed, {} ships lost, {} steps in {:.1f}ms\n",
+            n + 1,
+            level,
+            result.outcome.levelsCompleted,
+            result.outcome.shipsLost,
+            result.timings.steps,
+            duration<double, std::milli>(result.elapsed).count());
+    }
+    double seconds = duration<double>(elapsed).count();
+    double busySeconds = duration<double>(busy).count();
+    std::cout << std::format(
+        "{} jobs ({} failed): {} Levels completed, {} ships lost\n"
+        "{} frames ({} simulation steps) in {:.3f}s: {:.0f} frames per second, "
+        "{:.1f}x parallel speedup\n",
+        jobs.size(),
+        failed,
+        levelsCompleted,
+        shipsLost,
+        total.frames,
+        total.steps,
+        seconds,
+        seconds > 0.0 ? total.frames / seconds : 0.0,
+        seconds > 0.0 ? busySeconds / seconds : 0.0);
+    std::cout << formatPhaseTimings(total);
+}
+
+} // namespace amaze
+} // namespace marengo
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "controller.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs many headless games at once, each with its own GameModel, View,
+// Controller and NullGraphicsAdapter, spread over a pool of threads. Used for
+// e.g. checking that every Level still plays out as its replay says it should.
+
+namespace marengo {
+namespace amaze {
+
+struct BatchJob {
+    int gameLevel { 0 };
+    std::string levelFile; // if set, used instead of gameLevel
+    // Where the input comes from: a replay (whose Level and seed are then
+    // used instead of the job's), or an input script, or neither
+    std::string replayFile;
+    std::string inputScript;
+    uint32_t seed { 1 };
+    uint64_t frames { 0 }; // zero for the default
+};
+
+struct BatchSettings {
+    std::string dataDir;
+    int screenWidth { 1920 };
+    int screenHeight { 1080 };
+    bool continuousCollision { false };
+    std::string distanceFieldCache;
+    unsigned tickRate { 100 };
+    uint64_t defaultFrames { 1000 }; // replays default to their own length
+    unsigned threads { 0 }; // zero for one per core
+};
+
+struct BatchResult {
+    std::string error; // set if the job couldn't be run
+    GameOutcome outcome;
+    PhaseTimings timings;
+    std::chrono::nanoseconds elapsed {};
+};
+
+// Reads a list of jobs, one per line:
+//     <level number or FILE> [replay:<FILE> | script:<FILE> | -] [seed] [frames]
+// Lines starting with # are comments.
+std::vector<BatchJob> loadBatchJobs(const std::string& fileName);
+
+// Returns the results in the same order as the jobs
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs, const BatchSettings& settings);
+
+// Each job's result, then the totals
+void printBatchReport(
+    const std::vector<BatchJob>& jobs,
+    const std::vector<BatchResult>& results,
+    std::chrono::nanoseconds elapsed);
+
+} // namespace amaze
+} // namespace marengo
@@ -0,0 +1,107 @@
+#include "cameratransform.h"
+#include "utils.h"
+
+#ifdef AMAZE_CAMERATRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+namespace marengo {
+namespace amaze {
+namespace cameratransform {
+
+Matrix fromCamera(const Camera& camera)
+{
+    // screen = scale * R * (world - centre) + offset, with R the usual rotation
+    // matrix. The translation is worked out in double precision as it involves
+    // the largest values.
+    double cosScaled = utils::cosine(camera.rotation) * camera.scale;
+    double sinScaled = utils::sine(camera.rotation) * camera.scale;
+    double tx = camera.offsetX - (cosScaled * camera.centreX - sinScaled * camera.centreY);
+    double ty = camera.offsetY - (sinScaled * camera.centreX + cosScaled * camera.centreY);
+    return { static_cast<float>(cosScaled),
+             static_cast<float>(-sinScaled),
+             static_cast<float>(sinScaled),
+             static_cast<float>(cosScaled),
+             static_cast<float>(tx),
+             static_cast<float>(ty) };
+}
+
+void transformScalar(const Matrix& m, float* x, float* y, size_t count)
+{
+    for (size_t n = 0; n < count; ++n) {
+        float px = x[n];
+        float py = y[n];
+        x[n] = m.a * px + m.b * py + m.tx;
+        y[n] = m.c * px + m.d * py + m.ty;
+    }
+}
+
+#ifdef AMAZE_CAMERATRANSFORM_X86
+
+void transformSse(const Matrix& m, float* x, float* y, size_t count)
+{
+    const __m128 a = _mm_set1_ps(m.a);
+    const __m128 b = _mm_set1_ps(m.b);
+    const __m128 c = _mm_set1_ps(m.c);
+    const __m128 d = _mm_set1_ps(m.d);
+    const __m128 tx = _mm_set1_ps(m.tx);
+    const __m128 ty = _mm_set1_ps(m.ty);
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4) {
+        __m128 px = _mm_loadu_ps(x + n);
+        __m128 py = _mm_loadu_ps(y + n);
+        _mm_storeu_ps(x + n, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, px), _mm_mul_ps(b, py)), tx));
+        _mm_storeu_ps(y + n, _mm_add_ps(_mm_add_ps(_mm_mul_ps(c, px), _mm_mul_ps(d, py)), ty));
+    }
+    transformScalar(m, x + n, y + n, count - n);
+}
+
+__attribute__((target("avx"))) void transformAvx(const Matrix& m, float* x, float* y, size_t count)
+{
+    const __m256 a = _mm256_set1_ps(m.a);
+    const __m256 b = _mm256_set1_ps(m.b);
+    const __m256 c = _mm256_set1_ps(m.c);
+    const __m256 d = _mm256_set1_ps(m.d);
+    const __m256 tx = _mm256_set1_ps(m.tx);
+    const __m256 ty = _mm256_set1_ps(m.ty);
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m256 px = _mm256_loadu_ps(x + n);
+        __m256 py = _mm256_loadu_ps(y + n);
+        _mm256_storeu_ps(
+            x + n, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, px), _mm256_mul_ps(b, py)), tx));
+        _mm256_storeu_ps(
+            y + n, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c, px), _mm256_mul_ps(d, py)), ty));
+    }
+    transformSse(m, x + n, y + n, count - n);
+}
+
+#endif
+
+namespace {
+
+TransformFn selectTransform()
+{
+#ifdef AMAZE_CAMERATRANSFORM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) {
+        return transformAvx;
+    }
+    // SSE is always present on x86-64
+    return transformSse;
+#else
+    return transformScalar;
+#endif
+}
+
+} // namespace
+
+TransformFn bestTransform()
+{
+    static const TransformFn fn = selectTransform();
+    return fn;
+}
+
+} // namespace cameratransform
+} // namespace amaze
+} // namespace marengo
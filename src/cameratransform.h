@@ -0,0 +1,45 @@
+#pragma once
+
+#include "igraphicsadapter.h"
+
+#include <cstddef>
+
+// World to screen transformation of many points at once. The camera's
+// rotation, scale and translation are combined into one 2x3 matrix per frame
+// (so no trig per point), which is then applied to arrays of x and y
+// coordinates several points at a time using SIMD where the CPU supports it.
+
+namespace marengo {
+namespace amaze {
+namespace cameratransform {
+
+// screenX = a * x + b * y + tx
+// screenY = c * x + d * y + ty
+struct Matrix {
+    float a;
+    float b;
+    float c;
+    float d;
+    float tx;
+    float ty;
+};
+
+Matrix fromCamera(const Camera& camera);
+
+// Transforms points [0, count) in place
+using TransformFn = void (*)(const Matrix& m, float* x, float* y, size_t count);
+
+void transformScalar(const Matrix& m, float* x, float* y, size_t count);
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define AMAZE_CAMERATRANSFORM_X86
+void transformSse(const Matrix& m, float* x, float* y, size_t count);
+void transformAvx(const Matrix& m, float* x, float* y, size_t count);
+#endif
+
+// Returns the fastest version supported by this CPU (checked once, at first call)
+TransformFn bestTransform();
+
+} // namespace cameratransform
+} // namespace amaze
+} // namespace marengo
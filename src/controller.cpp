@@ -1,14 +1,80 @@
 #include "controller.h"
+#include "exceptions.h"
 #include "gameshape.h"
 #include "log.h" // IWYU pragma: keep
 #include "utils.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <format>
 #include <memory>
 
 namespace marengo {
 namespace amaze {
 
+namespace {
+
+// How long the countdown is before play starts
+constexpr unsigned respawnSeconds = 2;
+// How long after a Level ends (either way) before the menu appears
+constexpr unsigned levelEndedSeconds = 3;
+
+bool isShipControl(KeyControls key)
+{
+    return key == KeyControls::LEFT || key == KeyControls::RIGHT
+        || key == KeyControls::ACCELERATE || key == KeyControls::LR_ANALOGUE;
+}
+
+// Replays are saved every few seconds as they play, so that seeking back only
+// has to run on from the keyframe before
+constexpr unsigned keyframeSeconds = 5;
+constexpr unsigned replaySeekSeconds = 10;
+
+// Cycled through with the accelerate key while replaying, after which it's
+// played as fast as possible
+constexpr std::array<double, 3> replaySpeeds = { 1.0, 2.0, 8.0 };
+
+// Adds the time until it goes out of scope to a PhaseTimings member
+class PhaseTimer {
+public:
+    explicit PhaseTimer(std::chrono::nanoseconds& total)
+        : m_total(total)
+        , m_start(std::chrono::steady_clock::now())
+    {
+    }
+    ~PhaseTimer()
+    {
+        m_total += std::chrono::steady_clock::now() - m_start;
+    }
+
+private:
+    std::chrono::nanoseconds& m_total;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace
+
+std::string formatPhaseTimings(const PhaseTimings& timings)
+{
+    using namespace std::chrono;
+    std::string result;
+    auto phase = [&](const char* name, nanoseconds total) {
+        double ms = duration<double, std::milli>(total).count();
+        double usPerFrame = timings.frames > 0 ? ms * 1000.0 / timings.frames : 0.0;
+        result += std::format("  {:<12}{:>10.1f}ms{:>10.1f}us/frame\n", name, ms, usPerFrame);
+    };
+    phase("level load", timings.levelLoad);
+    phase("schedule", timings.schedule);
+    phase("input", timings.input);
+    phase("simulation", timings.simulation);
+    phase("collisions", timings.collisions);
+    phase("view", timings.view);
+    phase("redraw", timings.redraw);
+    return result;
+}
+
 Controller::Controller(GameModel& m, View& v, IGraphicsAdapter& g)
     : m_gameModel(m)
     , m_view(v)
@@ -33,10 +99,11 @@ void Controller::registerControlHandlers()
     // having to refer to (for example) SFML-specific keycodes outside of
     // the graphics manager. Using lambdas here but std::function can
     // contain functions, lambda expressions, bind expressions, or other
-    // function objects.
+    // function objects. They're also kept in our own table, from which
+    // replays are played back.
 
     // Rotate Left
-    m_graphicsAdapter.registerControlHandler(
+    addControlHandler(
         KeyControls::LEFT, [&](const bool isKeyDown, const float value) {
             if (isKeyDown) {
                 m_gameModel.getShipModel()->setRotationDelta(value);
@@ -49,7 +116,7 @@ void Controller::registerControlHandlers()
         });
 
     // Rotate with analogue stick
-    m_graphicsAdapter.registerControlHandler(
+    addControlHandler(
         KeyControls::LR_ANALOGUE, [&](const bool /* isKeyDown */, const float value) {
             double rotationDelta = value;
             if (std::abs(rotationDelta) < 0.01) {
@@ -59,7 +126,7 @@ void Controller::registerControlHandlers()
         });
 
     // Rotate Right
-    m_graphicsAdapter.registerControlHandler(
+    addControlHandler(
         KeyControls::RIGHT, [&](const bool isKeyDown, const float value) {
             if (isKeyDown) {
                 m_gameModel.getShipModel()->setRotationDelta(value);
@@ -72,7 +139,7 @@ void Controller::registerControlHandlers()
         });
 
     // Accelerate
-    m_graphicsAdapter.registerControlHandler(
+    addControlHandler(
         KeyControls::ACCELERATE, [&](const bool isKeyDown, const float acceleration) {
             if (isKeyDown) {
                 float accln = acceleration / 1000.f;
@@ -83,26 +150,27 @@ void Controller::registerControlHandlers()
         });
 
     // Pause
-    m_graphicsAdapter.registerControlHandler(
+    addControlHandler(
         KeyControls::PAUSE, [&](const bool isKeyDown, const float) {
-            int now = m_graphicsAdapter.getTicks();
+            // Timed in simulation steps (half a second's worth), rather than
+            // by the clock, so that replays pause exactly as recorded
             if (isKeyDown
                 && (m_gameModel.getGameState() == GameState::Running
                     || m_gameModel.getGameState() == GameState::Paused)
-                && now > m_lastPause + 500) {
+                && m_step > m_lastPause + m_tickRate / 2) {
                 m_gameModel.togglePause();
-                m_lastPause = m_graphicsAdapter.getTicks();
+                m_lastPause = m_step;
             }
         });
 
     // Menu
-    m_graphicsAdapter.registerControlHandler(KeyControls::MENU, [&](const bool, const float) {
+    addControlHandler(KeyControls::MENU, [&](const bool, const float) {
         m_gameModel.resetMenuPosition();
         m_gameModel.setGameState(GameState::Menu);
     });
 
     // Quit
-    m_graphicsAdapter.registerControlHandler(
+    addControlHandler(
         KeyControls::QUIT, [&](const bool isKeyDown, const float) {
             if (isKeyDown) {
                 m_gameModel.setGameState(GameState::Quit);
@@ -110,142 +178,474 @@ void Controller::registerControlHandlers()
         });
 }
 
+void Controller::addControlHandler(
+    KeyControls key,
+    std::function<void(const bool, const float)> controlHandler)
+{
+    m_controlHandlers[key] = std::move(controlHandler);
+    m_graphicsAdapter.registerControlHandler(
+        key, [this, key](const bool isKeyDown, const float value) {
+            if (m_replay) {
+                // Live input controls the playback while replaying, except
+                // for quitting
+                if (key != KeyControls::QUIT) {
+                    replayControl(key, isKeyDown);
+                    return;
+                }
+            } else if (m_ignoreShipControls && isShipControl(key)) {
+                return;
+            } else if (m_recording) {
+                m_recording->events.push_back({ m_step, key, isKeyDown, value });
+            }
+            m_controlHandlers[key](isKeyDown, value);
+        });
+}
+
+void Controller::processInput(bool paused)
+{
+    // Live input is read by mainLoop() when replaying
+    if (!m_replay) {
+        m_graphicsAdapter.processInput(paused);
+    }
+    while (const ReplayEvent* event = nextReplayEvent()) {
+        auto it = m_controlHandlers.find(event->key);
+        if (it != m_controlHandlers.end()) {
+            it->second(event->isKeyDown, event->value);
+        }
+    }
+}
+
+KeyControls Controller::processMenuInput()
+{
+    if (m_replay) {
+        const ReplayEvent* event = nextReplayEvent();
+        return event ? event->key : KeyControls::NONE;
+    }
+    KeyControls key = m_graphicsAdapter.processMenuInput();
+    if (m_recording && key != KeyControls::NONE) {
+        m_recording->events.push_back({ m_step, key, true, 0.f });
+    }
+    return key;
+}
+
+const ReplayEvent* Controller::nextReplayEvent()
+{
+    if (m_replay && m_nextReplayEvent < m_replay->events.size()
+        && m_replay->events[m_nextReplayEvent].step <= m_step) {
+        return &m_replay->events[m_nextReplayEvent++];
+    }
+    return nullptr;
+}
+
+void Controller::replayControl(KeyControls key, bool isKeyDown)
+{
+    // Seeking is left to mainLoop(), as we're called from within a step
+    uint32_t seekSteps = replaySeekSeconds * m_tickRate;
+    switch (key) {
+        case KeyControls::ACCELERATE:
+            // Keys repeat while held, so only the first press counts
+            if (isKeyDown && !m_replaySpeedKeyDown) {
+                if (m_replaySpeed == 0.0) {
+                    m_replaySpeed = replaySpeeds.front();
+                } else {
+                    auto it = std::upper_bound(
+                        replaySpeeds.begin(), replaySpeeds.end(), m_replaySpeed);
+                    m_replaySpeed = it != replaySpeeds.end() ? *it : 0.0;
+                }
+            }
+            m_replaySpeedKeyDown = isKeyDown;
+            break;
+        case KeyControls::LEFT:
+            if (isKeyDown) {
+                m_seekTarget = m_step > seekSteps ? m_step - seekSteps : 0;
+            }
+            break;
+        case KeyControls::RIGHT:
+            if (isKeyDown) {
+                m_seekTarget = m_step + seekSteps;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool Controller::seek(uint32_t targetStep)
+{
+    if (!m_replay) {
+        return true;
+    }
+    targetStep = std::min(targetStep, m_replay->steps);
+    // Going back means starting again from the last keyframe before where
+    // we're going, as does going forward past a keyframe already saved
+    auto it = std::upper_bound(
+        m_keyframes.begin(), m_keyframes.end(), targetStep, [](uint32_t step, const Keyframe& k) {
+            return step < k.step;
+        });
+    if (it != m_keyframes.begin()) {
+        const Keyframe& keyframe = *std::prev(it);
+        if (targetStep < m_step || keyframe.step > m_step) {
+            m_step = keyframe.step;
+            m_lastPause = keyframe.lastPause;
+            m_nextReplayEvent = keyframe.nextReplayEvent;
+            m_scheduler = keyframe.scheduler;
+            m_outcome = keyframe.outcome;
+            m_gameModel.restore(keyframe.model);
+        }
+    }
+    // The steps skipped over are silent
+    m_seeking = true;
+    while (m_step < targetStep) {
+        if (!step()) {
+            m_seeking = false;
+            return false;
+        }
+    }
+    m_seeking = false;
+    m_graphicsAdapter.rumble(0, 0, 0);
+    // So that the next frame is drawn exactly where we've got to
+    m_gameModel.saveStepStart();
+    return true;
+}
+
+const GameOutcome& Controller::outcome() const
+{
+    return m_outcome;
+}
+
+void Controller::recordReplay(Replay replay)
+{
+    m_recording = std::move(replay);
+    m_recording->events.clear();
+}
+
+const std::optional<Replay>& Controller::recording() const
+{
+    return m_recording;
+}
+
+void Controller::playReplay(Replay replay)
+{
+    m_replay = std::move(replay);
+    m_nextReplayEvent = 0;
+    setTickRate(m_replay->tickRate);
+    m_gameModel.setContinuousCollision(m_replay->continuousCollision);
+    m_keyframes.clear();
+}
+
+void Controller::setReplaySpeed(double speed)
+{
+    m_replaySpeed = speed;
+}
+
+void Controller::seekReplay(uint32_t step)
+{
+    m_seekTarget = step;
+}
+
+void Controller::setTickRate(unsigned ticksPerSecond)
+{
+    if (ticksPerSecond == 0) {
+        THROWUP(AmazeRuntimeException, "TickRate must be at least 1");
+    }
+    m_tickRate = ticksPerSecond;
+    m_gameModel.setTickRate(ticksPerSecond);
+}
+
+void Controller::setFrameRate(unsigned framesPerSecond)
+{
+    if (framesPerSecond == 0) {
+        THROWUP(AmazeRuntimeException, "FrameRate must be at least 1");
+    }
+    m_frameRate = framesPerSecond;
+}
+
+void Controller::setMaxCatchUpSteps(unsigned steps)
+{
+    if (steps == 0) {
+        THROWUP(AmazeRuntimeException, "MaxCatchUpSteps must be at least 1");
+    }
+    m_maxCatchUpSteps = steps;
+}
+
+void Controller::setFrameLimit(uint64_t frames)
+{
+    m_frameLimit = frames;
+}
+
+const PhaseTimings& Controller::phaseTimings() const
+{
+    return m_phaseTimings;
+}
+
 void Controller::mainLoop(int gameLevel, const std::string& levelFile)
 {
     // This is the main game control structure, called from main()
 
     // TODO splash screen?
     bool endingLevel = false;
-    m_graphicsAdapter.setFrameRate(100);
+    m_graphicsAdapter.setFrameRate(m_frameRate);
     m_graphicsAdapter.musicPlayLoop();
+    const double stepMs = 1000.0 / m_tickRate;
+    if (m_recording) {
+        m_recording->tickRate = m_tickRate;
+        m_recording->continuousCollision = m_gameModel.continuousCollision();
+    }
 
     // Main game loop
     for (;;) {
         m_gameModel.getShipModel()->setVisible(!endingLevel);
-        if (!levelFile.empty()) {
-            m_gameModel.levelLoad(levelFile);
-        } else {
-            m_gameModel.levelLoad(gameLevel);
+        {
+            PhaseTimer timer(m_phaseTimings.levelLoad);
+            if (!levelFile.empty()) {
+                m_gameModel.levelLoad(levelFile);
+            } else {
+                m_gameModel.levelLoad(gameLevel);
+            }
         }
         m_gameModel.setGameState(GameState::Running);
 
-        // Main loop per "life"
+        // Main loop per "life". The simulation is stepped at a fixed rate,
+        // however long frames take to draw, and each frame is drawn part
+        // way between the last two steps according to the time left over.
+        int lastTicks = m_graphicsAdapter.getTicks();
+        double unsimulatedMs = stepMs; // so the first frame has a step
         for (;;) {
-            m_scheduler.processSchedule();
-            if (endingLevel) {
-                goto end_loops;
+            if (m_replay) {
+                // Once a frame, whatever the replayed game is doing, for
+                // controlling the playback
+                m_graphicsAdapter.processInput(false);
             }
-            m_gameModel.savePosition();
-
-            switch (m_gameModel.getGameState()) {
-                case GameState::Menu:
-                    m_graphicsAdapter.rumble(0, 0, 0); // turn off any rumbles
-                    m_gameModel.getShipModel()->setIsAccelerating(false, 0.f);
-                    m_view.stopSounds();
-                    {
-                        KeyControls key = m_graphicsAdapter.processMenuInput();
-                        if (key == KeyControls::EXIT) {
-                            m_gameModel.setMenu("Main Menu");
-                            m_gameModel.getShipModel()->setVisible(true);
-                            m_gameModel.setGameState(GameState::Running);
-                        } else if (key == KeyControls::DOWN) {
-                            m_gameModel.menuDown();
-                        } else if (key == KeyControls::UP) {
-                            m_gameModel.menuUp();
-                        } else if (key == KeyControls::ENTER) {
-                            auto [selected, item] = m_gameModel.menuSelect();
-                            if (selected == MenuItemId::QUIT) {
-                                m_gameModel.setGameState(GameState::Quit);
-                            } else if (selected == MenuItemId::LEVEL_FILE) {
-                                if (item.has_value()) {
-                                    m_gameModel.setMenu("Main Menu");
-                                    m_gameModel.levelLoad(item.value().data);
-                                    m_gameModel.setGameState(GameState::Running);
-                                }
-                            }
-                        }
-                    }
-                    break;
-                case GameState::Paused:
-                    m_graphicsAdapter.rumble(0, 0, 0); // turn off any rumbles
-                    m_graphicsAdapter.processInput(true);
-                    m_view.stopSounds();
-                    break;
-                case GameState::Dead:
-                    // We get here when the ship has finished exploding
-                    m_graphicsAdapter.rumble(0, 0, 0);
-                    if (m_gameModel.lifeLost() != 0) {
-                        m_gameModel.restart();
-                        break;
+            if (m_seekTarget) {
+                uint32_t targetStep = *m_seekTarget;
+                m_seekTarget.reset();
+                if (!seek(targetStep)) {
+                    goto end_loops;
+                }
+                lastTicks = m_graphicsAdapter.getTicks();
+                unsimulatedMs = 0.0;
+            }
+            int ticks = m_graphicsAdapter.getTicks();
+            // Replays can be played faster than they were recorded
+            double speed = m_replay ? m_replaySpeed : 1.0;
+            unsimulatedMs += (ticks - lastTicks) * speed;
+            lastTicks = ticks;
+            // If we've fallen a long way behind (e.g. the window was being
+            // dragged) we give up on catching up, rather than the game
+            // running in fast forward until it has
+            unsimulatedMs = std::min(unsimulatedMs, m_maxCatchUpSteps * stepMs * speed);
+            if (speed == 0.0) {
+                // As fast as possible: as many steps as there's time for
+                // in one frame, by the clock as getTicks() may not be
+                auto frameEnd = std::chrono::steady_clock::now()
+                    + std::chrono::duration<double, std::milli>(1000.0 / m_frameRate);
+                do {
+                    if (endingLevel || !step()) {
+                        goto end_loops;
                     }
-                    m_scheduler.doAfter(ScheduleEventName::LevelEnded, 300, [&]() {
-                        // We just reload the level, but display the menu
-                        // in case the user wants a different level
-                        m_gameModel.levelLoad(m_gameModel.levelFileName());
-                        m_gameModel.getShipModel()->setVisible(false);
-                        m_gameModel.resetMenuPosition();
-                        m_gameModel.setGameState(GameState::Menu);
-                    });
-                    break;
-                case GameState::Quit:
+                } while (std::chrono::steady_clock::now() < frameEnd);
+                // Drawn exactly as the last step left it
+                m_gameModel.saveStepStart();
+            }
+            while (unsimulatedMs >= stepMs) {
+                unsimulatedMs -= stepMs;
+                if (endingLevel || !step()) {
                     // Break out of two loops, a justified use of goto :)
                     goto end_loops;
-                    break;
-                case GameState::Succeeded:
-                    m_view.stopSounds();
-                    m_graphicsAdapter.rumble(0, 0, 0); // turn off any rumbles
-                    m_gameModel.getShipModel()->shipGameShape()->resize(1.2);
-                    m_gameModel.getShipModel()->setIsAccelerating(false);
-                    m_gameModel.getShipModel()->flamesGameShape()->setVisible(false);
-                    m_gameModel.setBreakableExploding(false);
-                    m_scheduler.doAfter(ScheduleEventName::LevelEnded, 300, [&]() {
-                        // We just reload the level, but display the menu
-                        // in case the user wants a different level
-                        m_gameModel.levelLoad(m_gameModel.levelFileName());
-                        m_gameModel.getShipModel()->setVisible(false);
-                        m_gameModel.resetMenuPosition();
-                        m_gameModel.setGameState(GameState::Menu);
-                    });
-                    break;
-                case GameState::Exploding:
-                    m_graphicsAdapter.rumble(0xFFFF, 0xFFFF, 1000);
-                    m_gameModel.process(); // perform all processing required per loop
-                    break;
-                case GameState::Running:
-                    m_graphicsAdapter.processInput(false);
-                    m_gameModel.process(); // perform all processing required per loop
-                    collisionChecks();
-                    break;
-                default:
-                    break;
+                }
+            }
+            {
+                PhaseTimer timer(m_phaseTimings.view);
+                m_graphicsAdapter.cls();
+                m_view.update(unsimulatedMs / stepMs);
+            }
+            {
+                PhaseTimer timer(m_phaseTimings.redraw);
+                m_graphicsAdapter.redraw();
+            }
+            ++m_phaseTimings.frames;
+            if (m_frameLimit != 0 && m_phaseTimings.frames >= m_frameLimit) {
+                goto end_loops;
             }
-            m_graphicsAdapter.cls();
-            m_view.update();
-            m_graphicsAdapter.redraw();
         }
     }
 end_loops:
 }
 
+bool Controller::step()
+{
+    if (m_replay && m_step >= m_replay->steps) {
+        return false; // the end of the recording
+    }
+    if (m_replay && m_step % (keyframeSeconds * m_tickRate) == 0
+        && (m_keyframes.empty() || m_keyframes.back().step < m_step)) {
+        m_keyframes.push_back({ m_step,
+                                m_lastPause,
+                                m_nextReplayEvent,
+                                m_scheduler,
+                                m_outcome,
+                                m_gameModel.snapshot() });
+    }
+    ++m_step;
+    if (m_recording) {
+        m_recording->steps = m_step;
+    }
+    ++m_phaseTimings.steps;
+    m_gameModel.saveStepStart();
+    {
+        PhaseTimer timer(m_phaseTimings.schedule);
+        m_scheduler.processSchedule();
+    }
+    m_gameModel.savePosition();
+
+    switch (m_gameModel.getGameState()) {
+        case GameState::Menu:
+            rumble(0, 0, 0); // turn off any rumbles
+            m_gameModel.getShipModel()->setIsAccelerating(false, 0.f);
+            m_view.stopSounds();
+            {
+                KeyControls key = processMenuInput();
+                if (key == KeyControls::EXIT) {
+                    m_gameModel.setMenu("Main Menu");
+                    m_gameModel.getShipModel()->setVisible(true);
+                    m_gameModel.setGameState(GameState::Running);
+                } else if (key == KeyControls::DOWN) {
+                    m_gameModel.menuDown();
+                } else if (key == KeyControls::UP) {
+                    m_gameModel.menuUp();
+                } else if (key == KeyControls::ENTER) {
+                    auto [selected, item] = m_gameModel.menuSelect();
+                    if (selected == MenuItemId::QUIT) {
+                        m_gameModel.setGameState(GameState::Quit);
+                    } else if (selected == MenuItemId::LEVEL_FILE) {
+                        if (item.has_value()) {
+                            m_gameModel.setMenu("Main Menu");
+                            m_gameModel.levelLoad(item.value().data);
+                            m_gameModel.setGameState(GameState::Running);
+                        }
+                    }
+                }
+            }
+            break;
+        case GameState::Paused:
+            rumble(0, 0, 0); // turn off any rumbles
+            processInput(true);
+            m_view.stopSounds();
+            break;
+        case GameState::Dead:
+            // We get here when the ship has finished exploding
+            rumble(0, 0, 0);
+            if (m_gameModel.lifeLost() != 0) {
+                m_gameModel.restart();
+                respawn();
+                break;
+            }
+            showMenuLater();
+            break;
+        case GameState::Quit:
+            return false;
+        case GameState::Succeeded:
+            m_view.stopSounds();
+            rumble(0, 0, 0); // turn off any rumbles
+            m_gameModel.getShipModel()->shipGameShape()->resize(1.2);
+            m_gameModel.getShipModel()->setIsAccelerating(false);
+            m_gameModel.getShipModel()->flamesGameShape()->setVisible(false);
+            m_gameModel.setBreakableExploding(false);
+            showMenuLater();
+            break;
+        case GameState::Respawning:
+            // Only the menu and quitting work until play starts
+            m_ignoreShipControls = true;
+            processInput(false);
+            m_ignoreShipControls = false;
+            m_gameModel.setRespawnCountdown(
+                (m_scheduler.framesRemaining(ScheduleEventName::Respawning) + m_tickRate - 1)
+                / m_tickRate);
+            break;
+        case GameState::Exploding:
+            rumble(0xFFFF, 0xFFFF, 1000);
+            {
+                PhaseTimer timer(m_phaseTimings.simulation);
+                m_gameModel.process(); // perform all processing required per loop
+            }
+            break;
+        case GameState::Running:
+            {
+                PhaseTimer timer(m_phaseTimings.input);
+                processInput(false);
+            }
+            {
+                PhaseTimer timer(m_phaseTimings.simulation);
+                m_gameModel.process(); // perform all processing required per loop
+            }
+            {
+                PhaseTimer timer(m_phaseTimings.collisions);
+                collisionChecks();
+                proximityChecks();
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+void Controller::respawn()
+{
+    // Play starts after a countdown, during which everything else carries on
+    // as normal (drawing, sound, input) rather than the game freezing
+    m_gameModel.setGameState(GameState::Respawning);
+    m_gameModel.setRespawnCountdown(respawnSeconds);
+    m_scheduler.cancel(ScheduleEventName::Respawning);
+    m_scheduler.doAfter(ScheduleEventName::Respawning, respawnSeconds * m_tickRate, [&]() {
+        // Unless e.g. the menu was opened during the countdown
+        if (m_gameModel.getGameState() == GameState::Respawning) {
+            m_gameModel.setGameState(GameState::Running);
+        }
+    });
+}
+
+void Controller::showMenuLater()
+{
+    m_scheduler.doAfter(ScheduleEventName::LevelEnded, levelEndedSeconds * m_tickRate, [&]() {
+        // We just reload the level, but display the menu
+        // in case the user wants a different level
+        m_gameModel.levelLoad(m_gameModel.levelFileName());
+        m_gameModel.getShipModel()->setVisible(false);
+        m_gameModel.resetMenuPosition();
+        m_gameModel.setGameState(GameState::Menu);
+    });
+}
+
 void Controller::collisionChecks()
 {
-    // Collision detection
-    auto colliderTuple = m_gameModel.collisionDetect();
-    // collider is a tuple of GameShapeType and shared_ptr<GameShape>
-    std::shared_ptr<GameShape> collider = std::get<std::shared_ptr<GameShape>>(colliderTuple);
-    GameShapeType collideeType = std::get<GameShapeType>(colliderTuple);
-    if (collider) {
+    // Collision detection. Every contact is resolved, so e.g. fuel can be
+    // collected in the same frame as a breakable is destroyed.
+    m_gameModel.collisionDetect(m_contacts);
+    for (const auto& contact : m_contacts) {
+        if (m_gameModel.getGameState() != GameState::Running) {
+            // e.g. we've exploded, so nothing else we touched matters
+            break;
+        }
+        const auto& collider = contact.shape;
+        GameShapeType collideeType = contact.probeType;
+        if (!collider->IsActive()) {
+            // already dealt with this frame, e.g. a breakable hit by both
+            // the ship and the flames
+            continue;
+        }
         switch (collider->getGameShapeType()) {
             case GameShapeType::EXIT:
                 if (collideeType != GameShapeType::FLAMES) {
-                    m_graphicsAdapter.soundPlay("success");
+                    soundPlay("success");
                     m_gameModel.setGameState(GameState::Succeeded);
+                    ++m_outcome.levelsCompleted;
                 }
                 break;
             case GameShapeType::FUEL:
                 if (collideeType != GameShapeType::FLAMES) {
-                    m_graphicsAdapter.soundPlay("collect");
-                    collider->setIsActive(false);
+                    soundPlay("collect");
+                    m_gameModel.deactivateShape(collider);
                     m_gameModel.extraLife();
                 }
                 break;
@@ -257,22 +657,31 @@ void Controller::collisionChecks()
             case GameShapeType::OBSTRUCTION:
             case GameShapeType::MOVING:
                 if (collideeType != GameShapeType::FLAMES) {
+                    if (contact.timeOfImpact.has_value()) {
+                        // Explode where we hit the wall, not beyond it
+                        m_gameModel.getShipModel()->rewindPosition(*contact.timeOfImpact);
+                    }
                     m_gameModel.getShipModel()->setIsExploding(true);
                     m_gameModel.setGameState(GameState::Exploding);
+                    ++m_outcome.shipsLost;
                 }
                 break;
             case GameShapeType::BREAKABLE:
                 if (collideeType == GameShapeType::FLAMES) {
-                    m_graphicsAdapter.soundPlay("breakable");
+                    soundPlay("breakable");
                     m_gameModel.setBreakableExploding();
                 } else if (m_gameModel.lifeLost() > 0) {
-                    m_graphicsAdapter.soundPlay("breakable");
+                    soundPlay("breakable");
                     m_gameModel.setBreakableExploding();
                 } else {
+                    if (contact.timeOfImpact.has_value()) {
+                        m_gameModel.getShipModel()->rewindPosition(*contact.timeOfImpact);
+                    }
                     m_gameModel.getShipModel()->setIsExploding(true);
                     m_gameModel.setGameState(GameState::Exploding);
+                    ++m_outcome.shipsLost;
                 }
-                collider->setIsActive(false); // Breakable objects can be destroyed
+                m_gameModel.deactivateShape(collider); // Breakable objects can be destroyed
                 break;
             case GameShapeType::PRISONER:
                 // currently an idea but not used
@@ -285,5 +694,31 @@ void Controller::collisionChecks()
     }
 }
 
+void Controller::soundPlay(const std::string& key)
+{
+    if (!m_seeking) {
+        m_graphicsAdapter.soundPlay(key);
+    }
+}
+
+void Controller::rumble(uint16_t lowFreqIntensity, uint16_t highFreqIntensity, uint32_t durationMs)
+{
+    if (!m_seeking) {
+        m_graphicsAdapter.rumble(lowFreqIntensity, highFreqIntensity, durationMs);
+    }
+}
+
+void Controller::proximityChecks()
+{
+    // A near miss: rumble, more strongly the closer we are to the wall
+    if (m_gameModel.getGameState() != GameState::Running) {
+        return;
+    }
+    double proximity = m_gameModel.shipProximity();
+    if (proximity > 0.0) {
+        rumble(static_cast<uint16_t>(0x6000 * proximity), 0, 100);
+    }
+}
+
 } // namespace amaze
 } // namespace marengo
@@ -2,10 +2,18 @@
 
 #include "gamemodel.h"
 #include "igraphicsadapter.h"
+#include "replay.h"
 #include "scheduler.h"
 #include "view.h"
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 // This class acts as the MVC "controller" - i.e. it contains
 // game logic, tests input, collisions, end events etc
@@ -13,19 +21,121 @@
 namespace marengo {
 namespace amaze {
 
+// Time spent in each part of the main loop
+struct PhaseTimings {
+    std::chrono::nanoseconds levelLoad {};
+    std::chrono::nanoseconds schedule {}; // including Level reloads
+    std::chrono::nanoseconds input {};
+    std::chrono::nanoseconds simulation {};
+    std::chrono::nanoseconds collisions {};
+    std::chrono::nanoseconds view {};
+    std::chrono::nanoseconds redraw {};
+    uint64_t steps { 0 };
+    uint64_t frames { 0 };
+};
+
+// One line per phase: its total time and time per frame
+std::string formatPhaseTimings(const PhaseTimings& timings);
+
+// What happened during mainLoop()
+struct GameOutcome {
+    unsigned levelsCompleted { 0 };
+    unsigned shipsLost { 0 };
+};
+
 class Controller {
 public:
     Controller(GameModel& m, View& v, IGraphicsAdapter& s);
     void mainLoop(int gameLevel, const std::string& levelFile);
     void collisionChecks();
+    void proximityChecks();
     void registerControlHandlers();
+    // Simulation steps per second. The model scales its speeds and timings to
+    // suit, so this changes how finely the game is simulated (and what that
+    // costs), not how fast it plays. Call it before mainLoop().
+    void setTickRate(unsigned ticksPerSecond);
+    void setFrameRate(unsigned framesPerSecond);
+    // The most simulation steps run between two frames
+    void setMaxCatchUpSteps(unsigned steps);
+    // mainLoop() returns after this many frames; zero for no limit
+    void setFrameLimit(uint64_t frames);
+    const PhaseTimings& phaseTimings() const;
+    const GameOutcome& outcome() const;
+    // Records the input from now on into a copy of "replay" (whose seed and
+    // Level should be those about to be played), available from recording()
+    // once mainLoop() returns
+    void recordReplay(Replay replay);
+    const std::optional<Replay>& recording() const;
+    // Plays back a recording instead of live input. The model must have been
+    // given the replay's seed, and mainLoop() its Level; its tick rate and
+    // collision settings are applied here.
+    void playReplay(Replay replay);
+    // How many times faster than recorded a replay plays, or zero for as fast
+    // as possible. Only the last of the steps run for each frame is drawn.
+    void setReplaySpeed(double speed);
+    // Jumps to the given step of a replay before the next frame is drawn
+    void seekReplay(uint32_t step);
 
 private:
+    // Runs one simulation step. Returns false if the game is to quit.
+    bool step();
+    // Starts the countdown to play restarting after a life is lost
+    void respawn();
+    // Once a Level has ended (either way), shows the menu after a pause
+    void showMenuLater();
+    // Registers a handler with the graphics adapter (via our own table, so
+    // that input can be recorded and replayed)
+    void addControlHandler(
+        KeyControls key,
+        std::function<void(const bool, const float)> controlHandler);
+    // As the graphics adapter's, but recording or replaying input as needed
+    void processInput(bool paused);
+    KeyControls processMenuInput();
+    // The next replay event due in this step, if there is one
+    const ReplayEvent* nextReplayEvent();
+    // While replaying, the ship's controls control the playback instead
+    void replayControl(KeyControls key, bool isKeyDown);
+    // Runs (without drawing) from the nearest keyframe to the given step.
+    // Returns false if the game is to quit.
+    bool seek(uint32_t targetStep);
+    // The graphics adapter's, except while seeking
+    void soundPlay(const std::string& key);
+    void rumble(uint16_t lowFreqIntensity, uint16_t highFreqIntensity, uint32_t durationMs);
+
+    // Everything needed to carry on a replay from a given step
+    struct Keyframe {
+        uint32_t step;
+        uint32_t lastPause;
+        size_t nextReplayEvent;
+        Scheduler scheduler;
+        GameOutcome outcome;
+        GameModelSnapshot model;
+    };
+
     GameModel& m_gameModel;
     View& m_view;
     IGraphicsAdapter& m_graphicsAdapter;
-    int m_lastPause { 0 };
+    uint32_t m_lastPause { 0 }; // step
+    uint32_t m_step { 0 }; // simulation steps so far
     Scheduler m_scheduler;
+    std::vector<Contact> m_contacts; // reused by collisionChecks() each frame
+    unsigned m_tickRate { 100 };
+    unsigned m_frameRate { 100 };
+    unsigned m_maxCatchUpSteps { 5 };
+    uint64_t m_frameLimit { 0 };
+    PhaseTimings m_phaseTimings;
+    GameOutcome m_outcome;
+    std::unordered_map<KeyControls, std::function<void(const bool, const float)>>
+        m_controlHandlers;
+    std::optional<Replay> m_recording;
+    std::optional<Replay> m_replay;
+    size_t m_nextReplayEvent { 0 };
+    bool m_ignoreShipControls { false }; // e.g. during the respawn countdown
+    double m_replaySpeed { 1.0 };
+    bool m_replaySpeedKeyDown { false };
+    std::optional<uint32_t> m_seekTarget;
+    bool m_seeking { false };
+    std::vector<Keyframe> m_keyframes; // in step order, saved as the replay plays
 };
 
 } // namespace amaze
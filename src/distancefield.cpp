@@ -0,0 +1,394 @@
+#include "distancefield.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <random>
+
+namespace marengo {
+namespace amaze {
+
+namespace {
+
+constexpr char cacheMagic[8] = { 'A', 'M', 'Z', 'D', 'F', '0', '0', '2' };
+
+double distanceToSegment(double px, double py, double x0, double y0, double x1, double y1)
+{
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (lengthSquared > 0.0) {
+        t = std::clamp(((px - x0) * dx + (py - y0) * dy) / lengthSquared, 0.0, 1.0);
+    }
+    return std::hypot(px - (x0 + t * dx), py - (y0 + t * dy));
+}
+
+// FNV-1a
+void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t n = 0; n < size; ++n) {
+        hash ^= bytes[n];
+        hash *= 0x100000001b3ULL;
+    }
+}
+
+} // namespace
+
+void DistanceField::setCacheDirectory(const std::string& directory)
+{
+    m_cacheDirectory = directory;
+}
+
+bool DistanceField::isWall(GameShapeType type)
+{
+    return type == GameShapeType::OBSTRUCTION || type == GameShapeType::BREAKABLE;
+}
+
+void DistanceField::clear()
+{
+    m_distance.clear();
+    m_nearest.clear();
+    m_segments.clear();
+    m_segmentShapes.clear();
+    m_excluded.clear();
+    m_columns = 0;
+    m_rows = 0;
+}
+
+void DistanceField::build(const std::vector<std::shared_ptr<GameShape>>& shapes)
+{
+    clear();
+
+    BoundingBox extent;
+    for (const auto& shape : shapes) {
+        if (!isWall(shape->getGameShapeType())) {
+            continue;
+        }
+        if (!shape->IsActive()) {
+            m_excluded.push_back(shape.get());
+            continue;
+        }
+        for (const auto& sl : shape->getVec()) {
+            Segment s { sl.x0 + shape->getPosX(),
+                        sl.y0 + shape->getPosY(),
+                        sl.x1 + shape->getPosX(),
+                        sl.y1 + shape->getPosY() };
+            extent.minX = std::min({ extent.minX, s.x0, s.x1 });
+            extent.minY = std::min({ extent.minY, s.y0, s.y1 });
+            extent.maxX = std::max({ extent.maxX, s.x0, s.x1 });
+            extent.maxY = std::max({ extent.maxY, s.y0, s.y1 });
+            m_segments.push_back(s);
+            m_segmentShapes.push_back(shape.get());
+        }
+    }
+    if (m_segments.empty()) {
+        return;
+    }
+
+    // Always cover the whole arena, as the further from the walls we are the
+    // less accurate the estimate beyond the grid's edge is
+    extent.minX = std::min(extent.minX, 0.0);
+    extent.minY = std::min(extent.minY, 0.0);
+    extent.maxX = std::max(extent.maxX, m_arenaSize);
+    extent.maxY = std::max(extent.maxY, m_arenaSize);
+    m_originX = std::floor(extent.minX - m_border);
+    m_originY = std::floor(extent.minY - m_border);
+    m_columns = static_cast<int>((extent.maxX + m_border - m_originX) / m_cellSize) + 1;
+    m_rows = static_cast<int>((extent.maxY + m_border - m_originY) / m_cellSize) + 1;
+
+    uint64_t key = 0xcbf29ce484222325ULL;
+    hashBytes(key, m_segments.data(), m_segments.size() * sizeof(Segment));
+    hashBytes(key, &m_cellSize, sizeof(m_cellSize));
+    hashBytes(key, &m_border, sizeof(m_border));
+    if (loadCache(key)) {
+        return;
+    }
+    compute();
+    saveCache(key);
+}
+
+void DistanceField::removeShape(const GameShape* shape)
+{
+    if (m_distance.empty() || !isWall(shape->getGameShapeType())
+        || std::find(m_excluded.begin(), m_excluded.end(), shape) != m_excluded.end()) {
+        return;
+    }
+    m_excluded.push_back(shape);
+
+    // Forget the cells the shape was nearest to...
+    int minColumn = m_columns;
+    int minRow = m_rows;
+    int maxColumn = -1;
+    int maxRow = -1;
+    for (size_t cell = 0; cell < m_nearest.size(); ++cell) {
+        if (m_nearest[cell] < 0 || m_segmentShapes[m_nearest[cell]] != shape) {
+            continue;
+        }
+        m_distance[cell] = std::numeric_limits<float>::max();
+        m_nearest[cell] = -1;
+        int c = static_cast<int>(cell % m_columns);
+        int r = static_cast<int>(cell / m_columns);
+        minColumn = std::min(minColumn, c);
+        minRow = std::min(minRow, r);
+        maxColumn = std::max(maxColumn, c);
+        maxRow = std::max(maxRow, r);
+    }
+    // ...and fill them in from the walls around them
+    if (maxColumn >= 0) {
+        fill(minColumn, minRow, maxColumn, maxRow);
+    }
+}
+
+bool DistanceField::isUpToDate(const std::vector<std::shared_ptr<GameShape>>& shapes) const
+{
+    for (const auto& shape : shapes) {
+        if (!isWall(shape->getGameShapeType())) {
+            continue;
+        }
+        bool excluded
+            = std::find(m_excluded.begin(), m_excluded.end(), shape.get()) != m_excluded.end();
+        if (excluded == shape->IsActive()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DistanceField::compute()
+{
+    size_t cellCount = static_cast<size_t>(m_columns) * m_rows;
+    m_distance.assign(cellCount, std::numeric_limits<float>::max());
+    m_nearest.assign(cellCount, -1);
+
+    // Exact distances for the cells around each segment, then passed on to
+    // the rest
+    for (size_t s = 0; s < m_segments.size(); ++s) {
+        seedSegment(static_cast<int32_t>(s));
+    }
+    fill(0, 0, m_columns - 1, m_rows - 1);
+}
+
+void DistanceField::fill(int minColumn, int minRow, int maxColumn, int maxRow)
+{
+    // Sweeps down then back up the area (with a return sweep along each row).
+    // Because whole segments (rather than distances) are passed on, the
+    // result is very nearly exact.
+    for (int r = minRow; r <= maxRow; ++r) {
+        size_t rowStart = static_cast<size_t>(r) * m_columns;
+        for (int c = minColumn; c <= maxColumn; ++c) {
+            propagate(c - 1, r, rowStart + c);
+            propagate(c - 1, r - 1, rowStart + c);
+            propagate(c, r - 1, rowStart + c);
+            propagate(c + 1, r - 1, rowStart + c);
+        }
+        for (int c = maxColumn; c >= minColumn; --c) {
+            propagate(c + 1, r, rowStart + c);
+        }
+    }
+    for (int r = maxRow; r >= minRow; --r) {
+        size_t rowStart = static_cast<size_t>(r) * m_columns;
+        for (int c = maxColumn; c >= minColumn; --c) {
+            propagate(c + 1, r, rowStart + c);
+            propagate(c + 1, r + 1, rowStart + c);
+            propagate(c, r + 1, rowStart + c);
+            propagate(c - 1, r + 1, rowStart + c);
+        }
+        for (int c = minColumn; c <= maxColumn; ++c) {
+            propagate(c - 1, r, rowStart + c);
+        }
+    }
+}
+
+void DistanceField::seedSegment(int32_t segmentIndex)
+{
+    // Walk along the segment in half-cell steps, updating the cells around
+    // each point
+    const Segment& s = m_segments[segmentIndex];
+    double length = std::hypot(s.x1 - s.x0, s.y1 - s.y0);
+    int steps = static_cast<int>(std::ceil(length / (m_cellSize / 2.0)));
+    for (int i = 0; i <= steps; ++i) {
+        double t = (steps == 0) ? 0.0 : static_cast<double>(i) / steps;
+        int column = static_cast<int>((s.x0 + t * (s.x1 - s.x0) - m_originX) / m_cellSize);
+        int row = static_cast<int>((s.y0 + t * (s.y1 - s.y0) - m_originY) / m_cellSize);
+        for (int r = std::max(row - 1, 0); r <= std::min(row + 1, m_rows - 1); ++r) {
+            for (int c = std::max(column - 1, 0); c <= std::min(column + 1, m_columns - 1); ++c) {
+                size_t cell = static_cast<size_t>(r) * m_columns + c;
+                double d
+                    = distanceToSegment(cellCentreX(c), cellCentreY(r), s.x0, s.y0, s.x1, s.y1);
+                if (d < m_distance[cell]) {
+                    m_distance[cell] = static_cast<float>(d);
+                    m_nearest[cell] = segmentIndex;
+                }
+            }
+        }
+    }
+}
+
+void DistanceField::propagate(int column, int row, size_t cell)
+{
+    // Offers the segment nearest to the cell at (column, row) to "cell"
+    if (column < 0 || column >= m_columns || row < 0 || row >= m_rows) {
+        return;
+    }
+    int32_t candidate = m_nearest[static_cast<size_t>(row) * m_columns + column];
+    if (candidate < 0 || candidate == m_nearest[cell]) {
+        return;
+    }
+    const Segment& s = m_segments[candidate];
+    int c = static_cast<int>(cell % m_columns);
+    int r = static_cast<int>(cell / m_columns);
+    double d = distanceToSegment(cellCentreX(c), cellCentreY(r), s.x0, s.y0, s.x1, s.y1);
+    if (d < m_distance[cell]) {
+        m_distance[cell] = static_cast<float>(d);
+        m_nearest[cell] = candidate;
+    }
+}
+
+double DistanceField::cellCentreX(int column) const
+{
+    return m_originX + (column + 0.5) * m_cellSize;
+}
+
+double DistanceField::cellCentreY(int row) const
+{
+    return m_originY + (row + 0.5) * m_cellSize;
+}
+
+double DistanceField::sample(int column, int row) const
+{
+    return m_distance[static_cast<size_t>(row) * m_columns + column];
+}
+
+double DistanceField::distanceToNearestWall(double x, double y) const
+{
+    if (m_distance.empty()) {
+        return std::numeric_limits<double>::max();
+    }
+    // Bilinear interpolation between the four surrounding cell centres
+    double fx = std::clamp((x - m_originX) / m_cellSize - 0.5, 0.0, m_columns - 1.0);
+    double fy = std::clamp((y - m_originY) / m_cellSize - 0.5, 0.0, m_rows - 1.0);
+    int c0 = static_cast<int>(fx);
+    int r0 = static_cast<int>(fy);
+    int c1 = std::min(c0 + 1, m_columns - 1);
+    int r1 = std::min(r0 + 1, m_rows - 1);
+    double tx = fx - c0;
+    double ty = fy - r0;
+    double top = sample(c0, r0) + (sample(c1, r0) - sample(c0, r0)) * tx;
+    double bottom = sample(c0, r1) + (sample(c1, r1) - sample(c0, r1)) * tx;
+    double d = top + (bottom - top) * ty;
+
+    // Beyond the grid, add on the distance to its edge (an overestimate)
+    double ox = x - std::clamp(x, m_originX, m_originX + m_columns * m_cellSize);
+    double oy = y - std::clamp(y, m_originY, m_originY + m_rows * m_cellSize);
+    return d + std::hypot(ox, oy);
+}
+
+std::pair<double, double> DistanceField::gradient(double x, double y) const
+{
+    if (m_distance.empty()) {
+        return { 0.0, 0.0 };
+    }
+    double h = m_cellSize;
+    return { (distanceToNearestWall(x + h, y) - distanceToNearestWall(x - h, y)) / (2.0 * h),
+             (distanceToNearestWall(x, y + h) - distanceToNearestWall(x, y - h)) / (2.0 * h) };
+}
+
+std::string DistanceField::cacheFileName(uint64_t key) const
+{
+    return (std::filesystem::path(m_cacheDirectory) / std::format("{:016x}.sdf", key)).string();
+}
+
+bool DistanceField::loadCache(uint64_t key)
+{
+    if (m_cacheDirectory.empty()) {
+        return false;
+    }
+    std::ifstream in(cacheFileName(key), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    char magic[sizeof(cacheMagic)];
+    uint64_t fileKey = 0;
+    int32_t columns = 0;
+    int32_t rows = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+    in.read(reinterpret_cast<char*>(&columns), sizeof(columns));
+    in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+    if (!in || std::memcmp(magic, cacheMagic, sizeof(magic)) != 0 || fileKey != key
+        || columns != m_columns || rows != m_rows) {
+        return false;
+    }
+    m_distance.resize(static_cast<size_t>(m_columns) * m_rows);
+    m_nearest.resize(m_distance.size());
+    in.read(
+        reinterpret_cast<char*>(m_distance.data()),
+        static_cast<std::streamsize>(m_distance.size() * sizeof(float)));
+    in.read(
+        reinterpret_cast<char*>(m_nearest.data()),
+        static_cast<std::streamsize>(m_nearest.size() * sizeof(int32_t)));
+    // A file from an older build, or a damaged one, could otherwise have
+    // removeShape() and the like index past the end of m_segments
+    auto segmentCount = static_cast<int32_t>(m_segments.size());
+    bool valid = static_cast<bool>(in);
+    for (size_t cell = 0; valid && cell < m_distance.size(); ++cell) {
+        valid = std::isfinite(m_distance[cell]) && m_nearest[cell] >= -1
+            && m_nearest[cell] < segmentCount;
+    }
+    if (!valid) {
+        mgo::Log::warn(std::format("Ignoring bad distance field cache {}", cacheFileName(key)));
+        m_distance.clear();
+        m_nearest.clear();
+        return false;
+    }
+    mgo::Log::debug(std::format("Loaded distance field from {}", cacheFileName(key)));
+    return true;
+}
+
+void DistanceField::saveCache(uint64_t key) const
+{
+    if (m_cacheDirectory.empty()) {
+        return;
+    }
+    // The cache is only an optimisation, so failing to write it isn't an error
+    std::error_code ec;
+    std::filesystem::create_directories(m_cacheDirectory, ec);
+    // Written under a name of its own and then renamed, so that a batch run
+    // loading the same Level on another thread (or in another process) never
+    // sees half a file
+    std::string fileName = cacheFileName(key);
+    std::string tempFileName = std::format("{}.{:08x}.tmp", fileName, std::random_device {}());
+    std::ofstream out(tempFileName, std::ios::binary | std::ios::trunc);
+    int32_t columns = m_columns;
+    int32_t rows = m_rows;
+    out.write(cacheMagic, sizeof(cacheMagic));
+    out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    out.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+    out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    out.write(
+        reinterpret_cast<const char*>(m_distance.data()),
+        static_cast<std::streamsize>(m_distance.size() * sizeof(float)));
+    out.write(
+        reinterpret_cast<const char*>(m_nearest.data()),
+        static_cast<std::streamsize>(m_nearest.size() * sizeof(int32_t)));
+    out.close();
+    if (!out) {
+        mgo::Log::warn(std::format("Could not write distance field to {}", fileName));
+        std::filesystem::remove(tempFileName, ec);
+        return;
+    }
+    std::filesystem::rename(tempFileName, fileName, ec);
+    if (ec) {
+        std::filesystem::remove(tempFileName, ec);
+    }
+}
+
+} // namespace amaze
+} // namespace marengo
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "gameshape.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A distance field over the Level's walls (OBSTRUCTION and BREAKABLE shapes):
+// a grid holding, for each cell, the distance from its centre to the nearest
+// wall line. It is built once per Level load, after which "how close is the
+// nearest wall?" is a couple of array lookups wherever you are, rather than a
+// scan of every line in the Level.
+//
+// Building it takes a few tens of milliseconds for a typical Level, so it can
+// optionally be cached on disk; the cache file name is derived from a hash of
+// the geometry, so a changed Level simply gets a new entry.
+//
+// Breakables which are destroyed during play are taken out with removeShape(),
+// which only recalculates the cells they were the nearest wall to.
+
+namespace marengo {
+namespace amaze {
+
+class DistanceField {
+public:
+    // If set (to a directory), fields are loaded from / saved to it
+    void setCacheDirectory(const std::string& directory);
+
+    void clear();
+    // Inactive shapes are left out
+    void build(const std::vector<std::shared_ptr<GameShape>>& shapes);
+    // Stops a wall counting, e.g. a destroyed breakable
+    void removeShape(const GameShape* shape);
+    // True if the field has the walls that build() would give it now, i.e.
+    // no shapes have been re-activated since (or deactivated but not removed)
+    bool isUpToDate(const std::vector<std::shared_ptr<GameShape>>& shapes) const;
+
+    // Distance (in units) from (x, y) to the nearest wall. Interpolated between
+    // cell centres, so accurate to around a unit. Returns a large value if the
+    // Level has no walls.
+    double distanceToNearestWall(double x, double y) const;
+    // Gradient of the distance at (x, y): roughly a unit vector pointing
+    // directly away from the nearest wall (zero if there are no walls)
+    std::pair<double, double> gradient(double x, double y) const;
+
+private:
+    struct Segment {
+        double x0;
+        double y0;
+        double x1;
+        double y1;
+    };
+
+    static bool isWall(GameShapeType type);
+    void compute();
+    void seedSegment(int32_t segmentIndex);
+    // Passes each cell's nearest segment on to its neighbours, for the cells
+    // in columns [minColumn, maxColumn] of rows [minRow, maxRow]
+    void fill(int minColumn, int minRow, int maxColumn, int maxRow);
+    void propagate(int column, int row, size_t cell);
+    double cellCentreX(int column) const;
+    double cellCentreY(int row) const;
+    double sample(int column, int row) const;
+
+    std::string cacheFileName(uint64_t key) const;
+    bool loadCache(uint64_t key);
+    void saveCache(uint64_t key) const;
+
+    static constexpr double m_cellSize { 4.0 };
+    // Extra room around the walls' extent, so that the field is still useful
+    // just outside the Level
+    static constexpr double m_border { 64.0 };
+    static constexpr double m_arenaSize { 2000.0 };
+
+    std::string m_cacheDirectory;
+
+    // World coordinates of the top left of cell (0, 0)
+    double m_originX { 0.0 };
+    double m_originY { 0.0 };
+    int m_columns { 0 };
+    int m_rows { 0 };
+    std::vector<float> m_distance;
+    // Index of the nearest segment to each cell (-1 if there are no walls)
+    std::vector<int32_t> m_nearest;
+    std::vector<Segment> m_segments;
+    std::vector<const GameShape*> m_segmentShapes; // which shape each segment is from
+    // Walls which are left out, having been inactive or removed
+    std::vector<const GameShape*> m_excluded;
+};
+
+} // namespace amaze
+} // namespace marengo
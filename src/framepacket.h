@@ -0,0 +1,75 @@
+#pragma once
+
+#include "igraphicsadapter.h"
+
+#include <memory>
+#include <variant>
+#include <vector>
+
+// Everything needed to draw one frame. SfmlAdapter records one of these as
+// the View draws (on the simulation thread) and its render thread then
+// replays it, so the simulation never waits for the GPU.
+
+namespace marengo {
+namespace amaze {
+
+struct FramePacket {
+    // Commands, one per drawing call made by the View
+    struct Lines {
+        size_t first; // index into "lines"
+        size_t count;
+    };
+    struct LineQuads {
+        size_t first; // index into "quads"
+        size_t count;
+    };
+    struct StaticLines {
+        Camera camera;
+    };
+    struct GridLayer {
+        Grid grid;
+        Camera camera;
+    };
+    // The frame as it was when captureBackdrop() was called, dimmed. The
+    // render thread captures it from "source" the first time it sees a new
+    // generation, so it doesn't matter if it skips the packet in which
+    // captureBackdrop() was called.
+    struct Backdrop {
+        std::shared_ptr<const FramePacket> source;
+        float brightness;
+        unsigned generation;
+    };
+    struct StatusBar { };
+    using Command = std::variant<
+        Lines,
+        LineQuads,
+        StaticLines,
+        GridLayer,
+        Backdrop,
+        StatusBar,
+        Text>;
+
+    // Keeps the vectors' capacity, so recording a frame doesn't allocate
+    void clear()
+    {
+        commands.clear();
+        lines.clear();
+        quads.clear();
+    }
+
+    std::vector<Command> commands; // in drawing order
+    std::vector<LineInstance> lines;
+    std::vector<LineQuad> quads;
+    // Only replaced when the static lines change, so every packet until then
+    // shares the same copy
+    std::shared_ptr<const std::vector<LineInstance>> staticLines;
+    // Which of them are shown, likewise only replaced when that changes
+    std::shared_ptr<const std::vector<bool>> staticLinesShown;
+    // The window's size as the packet was recorded, which the render thread
+    // sets its view to before drawing it
+    unsigned windowWidth { 0 };
+    unsigned windowHeight { 0 };
+};
+
+} // namespace amaze
+} // namespace marengo
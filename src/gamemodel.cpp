@@ -1,20 +1,26 @@
 #include "gamemodel.h"
 #include "exceptions.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
-#include <chrono>
 #include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <map>
-#include <regex>
-#include <thread>
 
 namespace marengo {
 namespace amaze {
 
 namespace {
 
+// Roughly the ship's radius, and the distance (from its centre) at which a
+// wall counts as close, for shipProximity()
+constexpr double shipRadius = 20.0;
+constexpr double proximityRange = 50.0;
+
+constexpr double explosionSeconds = 0.4;
+
 std::string getLevelDescription(std::filesystem::path levelFile)
 {
     std::ifstream in(levelFile.string());
@@ -38,8 +44,7 @@ std::string getLevelDescription(std::filesystem::path levelFile)
 GameModel::GameModel(const std::string& dataPath)
     : m_dataPath(dataPath)
 {
-    m_shipModel
-        = std::make_unique<ShipModel>(ShipModel(newGameShape(), newGameShape(), newGameShape()));
+    m_shipModel = newShipModel();
 
     // Populate the menu structure
     m_menu.addMenuItem(
@@ -47,13 +52,14 @@ GameModel::GameModel(const std::string& dataPath)
     m_menu.addMenuItem("Main Menu", { "Main Menu", MenuItemId::OPTIONS, "Options", 1 });
     m_menu.addMenuItem("Main Menu", { "Main Menu", MenuItemId::QUIT, "Quit", 2 });
 
-    // Sub-menu for level selection
-    std::regex regexPattern("^level.*cfg$");
+    // Sub-menu for level selection. (Not matched with std::regex, whose
+    // parsing touches the shared global locale, as batch runs construct
+    // GameModels on several threads at once.)
     std::map<int, std::filesystem::path> sortedPaths;
     for (const auto& entry : std::filesystem::directory_iterator(dataPath)) {
         if (entry.is_regular_file()) {
             const std::string fileName = entry.path().filename().string();
-            if (std::regex_match(fileName, regexPattern)) {
+            if (fileName.starts_with("level") && fileName.ends_with("cfg")) {
                 std::string num;
                 for (const auto c : fileName) {
                     if (isdigit(c)) {
@@ -102,27 +108,20 @@ void GameModel::initialise(const std::string& levelFileName)
     // Resets the model to a state ready for a new Level
     m_livesRemaining = 1;
     m_allDynamicGameShapes.clear();
+    m_staticGeometry.clear();
+    m_occupancyGrid.clear();
+    m_distanceField.clear();
+    ++m_staticShapesVersion;
+    // Never a number used before, even if restore() has gone back to an
+    // earlier one
+    m_levelGeneration = ++m_levelLoads;
 
     m_shipModel.reset();
-    m_shipModel
-        = std::make_unique<ShipModel>(ShipModel(newGameShape(), newGameShape(), newGameShape()));
+    m_shipModel = newShipModel();
 
     buildBreakableExplosionShape();
     m_allDynamicGameShapes.push_back(m_breakableExplosionShape);
 
-    // Grid lines on the background
-    std::shared_ptr<GameShape> bkg(new GameShape);
-    for (double n = 0; n <= 2000; n += 50) {
-        ShapeLine sl1 { n, 0, n, 2000, 0, 32, 0, 255, 4 };
-        bkg->addShapeLine(sl1);
-        ShapeLine sl2 { 0, n, 2000, n, 0, 32, 0, 255, 4 };
-        bkg->addShapeLine(sl2);
-    }
-    bkg->setPos(0, 0);
-    bkg->setName("Background");
-    bkg->setGameShapeType(GameShapeType::NEUTRAL);
-    m_allDynamicGameShapes.push_back(std::move(bkg));
-
     m_allDynamicGameShapes.push_back(m_shipModel->shipGameShape());
     m_allDynamicGameShapes.push_back(m_shipModel->flamesGameShape());
     m_allDynamicGameShapes.push_back(m_shipModel->explosionGameShape());
@@ -142,13 +141,13 @@ void GameModel::buildBreakableExplosionShape()
     }
     m_breakableExplosionShape->clear();
     for (int n = 0; n < 11; ++n) {
-        if (utils::rnd(5) == 1) {
+        if (m_random.rnd(5) == 1) {
             continue;
         }
-        double x1 = static_cast<double>(sine(n * 30.0) * 20 + (utils::rnd(10)));
-        double y1 = static_cast<double>(cosine(n * 30.0) * 20 + (utils::rnd(10)));
-        double x2 = static_cast<double>(sine((n + 1) * 30.0) * 20 + (utils::rnd(10)));
-        double y2 = static_cast<double>(cosine((n + 1) * 30.0) * 20 + (utils::rnd(10)));
+        double x1 = static_cast<double>(sine(n * 30.0) * 20 + (m_random.rnd(10)));
+        double y1 = static_cast<double>(cosine(n * 30.0) * 20 + (m_random.rnd(10)));
+        double x2 = static_cast<double>(sine((n + 1) * 30.0) * 20 + (m_random.rnd(10)));
+        double y2 = static_cast<double>(cosine((n + 1) * 30.0) * 20 + (m_random.rnd(10)));
         m_breakableExplosionShape->addShapeLine(ShapeLine { x1, y1, x2, y2, 255, 150, 50, 255, 6 });
     }
     m_breakableExplosionShape->setName("BreakableExplosion");
@@ -302,6 +301,12 @@ void GameModel::levelLoad(const std::string& filename)
     in.close();
     addPreviousObject(obj);
     setLevelFileName(filename);
+
+    m_staticGeometry.build(m_allDynamicGameShapes);
+    m_occupancyGrid.build(m_allDynamicGameShapes);
+    m_distanceField.build(m_allDynamicGameShapes);
+    ++m_staticShapesVersion;
+    saveStepStart(); // no interpolating from where we were in the last Level
 }
 
 void GameModel::addPreviousObject(std::unique_ptr<marengo::amaze::GameShape>& obj)
@@ -344,10 +349,68 @@ ShipModel* GameModel::getShipModel() const
     return m_shipModel.get();
 }
 
-std::tuple<GameShapeType, std::shared_ptr<GameShape>> GameModel::collisionDetect() const
+void GameModel::collisionDetect(std::vector<Contact>& contacts) const
 {
+    contacts.clear();
+    const auto& ship = m_shipModel->shipGameShape();
+    const auto& flames = m_shipModel->flamesGameShape();
+
+    // Most of the time there is no static geometry anywhere near the ship,
+    // in which case the static index needn't be searched at all
+    BoundingBox probeBounds = ship->getBounds();
+    if (m_continuousCollision) {
+        double dx = m_shipModel->previousX() - ship->getPosX();
+        double dy = m_shipModel->previousY() - ship->getPosY();
+        probeBounds.minX = std::min(probeBounds.minX, probeBounds.minX + dx);
+        probeBounds.minY = std::min(probeBounds.minY, probeBounds.minY + dy);
+        probeBounds.maxX = std::max(probeBounds.maxX, probeBounds.maxX + dx);
+        probeBounds.maxY = std::max(probeBounds.maxY, probeBounds.maxY + dy);
+    }
+    if (flames->isVisible() && !flames->getVec().empty()) {
+        BoundingBox flamesBounds = flames->getBounds();
+        probeBounds.minX = std::min(probeBounds.minX, flamesBounds.minX);
+        probeBounds.minY = std::min(probeBounds.minY, flamesBounds.minY);
+        probeBounds.maxX = std::max(probeBounds.maxX, flamesBounds.maxX);
+        probeBounds.maxY = std::max(probeBounds.maxY, flamesBounds.maxY);
+    }
+    bool staticNearby = !m_occupancyGrid.isEmpty(probeBounds);
+
+    m_sweepHits.clear();
+    if (m_continuousCollision && staticNearby) {
+        m_staticGeometry.sweep(
+            *ship, m_shipModel->previousX(), m_shipModel->previousY(), m_sweepHits);
+    }
+    bool swept = !m_sweepHits.empty();
+
+    // The shapes which can collide with things. The ship is always the
+    // first.
+    std::array<const Shape*, 2> probes {};
+    std::array<GameShapeType, 2> probeTypes {};
+    uint32_t probeCount = 0;
+    probes[probeCount] = ship.get();
+    probeTypes[probeCount++] = GameShapeType::SHIP;
+    if (flames->isVisible()) {
+        probes[probeCount] = flames.get();
+        probeTypes[probeCount++] = GameShapeType::FLAMES;
+    }
+
+    // Non-moving Level geometry is tested for all probes at once via the
+    // static index, which only looks at lines near them. Everything else is
+    // tested in full below.
+    m_staticHits.clear();
+    if (staticNearby) {
+        m_staticGeometry.query(std::span(probes.data(), probeCount), m_staticHits);
+    }
+    auto wasHit = [this](uint32_t probe, const GameShape* shape) {
+        return std::find_if(
+                   m_staticHits.begin(),
+                   m_staticHits.end(),
+                   [&](const ProbeHit& hit) { return hit.probe == probe && hit.shape == shape; })
+            != m_staticHits.end();
+    };
+
     for (const auto& obj : m_allDynamicGameShapes) {
-        if (obj == m_shipModel->shipGameShape() || obj == m_shipModel->flamesGameShape()) {
+        if (obj == ship || obj == flames) {
             // can't collide with itself :)
             continue;
         }
@@ -358,17 +421,112 @@ std::tuple<GameShapeType, std::shared_ptr<GameShape>> GameModel::collisionDetect
         if (obj->IsActive() == false) {
             continue;
         }
-        if (m_shipModel->shipGameShape()->intersectCheck(obj)) {
-            return { GameShapeType::SHIP, obj };
+        bool indexed = StaticGeometry::isIndexed(obj->getGameShapeType());
+        if (indexed && swept) {
+            auto hit = std::find_if(m_sweepHits.begin(), m_sweepHits.end(), [&](const auto& h) {
+                return h.shape == obj.get();
+            });
+            if (hit != m_sweepHits.end()) {
+                contacts.push_back({ GameShapeType::SHIP, obj, hit->time });
+            }
         }
-        if (m_shipModel->flamesGameShape()->isVisible()
-            && m_shipModel->flamesGameShape()->intersectCheck(obj)) {
-            if (obj->getGameShapeType() == GameShapeType::BREAKABLE) {
-                return { GameShapeType::FLAMES, obj };
+        for (uint32_t p = 0; p < probeCount; ++p) {
+            // If the ship's sweep found something, that's the ship's only
+            // contact with static geometry: what was touched on the way takes
+            // precedence over anything the ship overlaps at its final
+            // position. Moving shapes are still tested as usual.
+            if (indexed && p == 0 && swept) {
+                continue;
+            }
+            if (indexed ? wasHit(p, obj.get()) : probes[p]->intersectCheck(obj)) {
+                contacts.push_back({ probeTypes[p], obj, std::nullopt });
             }
         }
     }
-    return { GameShapeType::NEUTRAL, nullptr };
+    // Whatever the ship touched on its way comes first, in the order it
+    // touched them, so e.g. it explodes on a wall before reaching the exit
+    if (swept) {
+        std::stable_sort(contacts.begin(), contacts.end(), [](const Contact& a, const Contact& b) {
+            return a.timeOfImpact.has_value()
+                && (!b.timeOfImpact.has_value() || *a.timeOfImpact < *b.timeOfImpact);
+        });
+    }
+}
+
+void GameModel::setTickRate(unsigned ticksPerSecond)
+{
+    m_tickRate = ticksPerSecond;
+    m_stepScale = static_cast<double>(referenceTickRate) / ticksPerSecond;
+    m_savedPositionsRingBuffer
+        = utils::RingBuffer<ShipPosition>(savedPositionsSeconds * m_tickRate);
+    m_shipModel->setStepScale(m_stepScale);
+}
+
+int GameModel::steps(double seconds) const
+{
+    return static_cast<int>(std::lround(seconds * m_tickRate));
+}
+
+std::unique_ptr<ShipModel> GameModel::newShipModel()
+{
+    auto shipModel = std::make_unique<ShipModel>(
+        ShipModel(newGameShape(), newGameShape(), newGameShape(), m_random));
+    shipModel->setStepScale(m_stepScale);
+    return shipModel;
+}
+
+void GameModel::setContinuousCollision(bool value)
+{
+    m_continuousCollision = value;
+}
+
+bool GameModel::continuousCollision() const
+{
+    return m_continuousCollision;
+}
+
+const DistanceField& GameModel::distanceField() const
+{
+    return m_distanceField;
+}
+
+double GameModel::shipProximity() const
+{
+    double distance = m_distanceField.distanceToNearestWall(m_shipModel->x(), m_shipModel->y());
+    return std::clamp((proximityRange - distance) / (proximityRange - shipRadius), 0.0, 1.0);
+}
+
+void GameModel::setDistanceFieldCacheDirectory(const std::string& directory)
+{
+    m_distanceField.setCacheDirectory(directory);
+}
+
+void GameModel::deactivateShape(const std::shared_ptr<GameShape>& shape)
+{
+    shape->setIsActive(false);
+    if (StaticGeometry::isIndexed(shape->getGameShapeType())) {
+        m_staticGeometry.removeShape(shape.get());
+    }
+    m_distanceField.removeShape(shape.get());
+    if (isStaticShape(*shape)) {
+        ++m_staticShapesVersion;
+    }
+}
+
+bool GameModel::isStaticShape(const GameShape& shape)
+{
+    return shape.getGameShapeType() == GameShapeType::NEUTRAL
+        || StaticGeometry::isIndexed(shape.getGameShapeType());
+}
+
+unsigned GameModel::staticShapesVersion() const
+{
+    return m_staticShapesVersion;
+}
+
+unsigned GameModel::levelGeneration() const
+{
+    return m_levelGeneration;
 }
 
 void GameModel::process() // TODO more descriptive name
@@ -378,14 +536,15 @@ void GameModel::process() // TODO more descriptive name
     if (m_gameState == GameState::Exploding) {
         m_shipModel->setIsExploding(true);
         m_shipModel->setVisible(false);
-        m_scheduler.doAfter(
-            ScheduleEventName::Exploding, 40, [&]() { setGameState(GameState::Dead); });
+        m_scheduler.doAfter(ScheduleEventName::Exploding, steps(explosionSeconds), [&]() {
+            setGameState(GameState::Dead);
+        });
     }
     if (m_breakableExploding) {
         m_breakableExplosionShape->setVisible(true);
         m_breakableExplosionShape->setPos(m_shipModel->x(), m_shipModel->y());
         m_breakableExplosionShape->resize(1.2);
-        m_scheduler.doAfter(ScheduleEventName::BreakableExploding, 40, [&]() {
+        m_scheduler.doAfter(ScheduleEventName::BreakableExploding, steps(explosionSeconds), [&]() {
             m_breakableExploding = false;
             buildBreakableExplosionShape();
         });
@@ -395,7 +554,7 @@ void GameModel::process() // TODO more descriptive name
     for (const auto& shape : m_allDynamicGameShapes) {
         if (shape->getGameShapeType() == GameShapeType::MOVING
             && m_gameState == GameState::Running) {
-            shape->move();
+            shape->move(m_stepScale);
         }
         if (shape->getGameShapeType() == GameShapeType::MOVING && shape->getGravity() != 0.f) {
 
@@ -405,7 +564,7 @@ void GameModel::process() // TODO more descriptive name
             if (shape->getScale() <= 0.99) {
                 shape->setPulsateAmount(0.001f);
             }
-            shape->resize(shape->getScale() + shape->getPulsateAmount());
+            shape->resize(shape->getScale() + shape->getPulsateAmount() * m_stepScale);
 
             double xDiff = shape->getPosX() - getShipModel()->x();
             double yDiff = shape->getPosY() - getShipModel()->y();
@@ -416,7 +575,7 @@ void GameModel::process() // TODO more descriptive name
             double distance = std::sqrt(distanceSquared);
             if (distance < shape->getGravity() * 25) {
                 auto* ship = getShipModel();
-                double forceMagnitude = shape->getGravity() / distanceSquared;
+                double forceMagnitude = shape->getGravity() / distanceSquared * m_stepScale;
                 double fx = (xDiff / distance) * forceMagnitude;
                 double fy = (yDiff / distance) * forceMagnitude;
                 ship->setDx(ship->dX() - fx);
@@ -436,6 +595,94 @@ unsigned int GameModel::getRotation() const
     return 0; // unused overridden function
 }
 
+void GameModel::saveStepStart()
+{
+    m_shipModel->saveStepStart();
+    for (const auto& shape : m_allDynamicGameShapes) {
+        if (!isStaticShape(*shape)) {
+            shape->saveStepStart();
+        }
+    }
+}
+
+GameModelSnapshot GameModel::snapshot() const
+{
+    GameModelSnapshot snapshot {
+        m_allDynamicGameShapes,
+        {},
+        {},
+        *m_shipModel,
+        m_breakableExplosionShape,
+        m_breakableExploding,
+        m_levelFileName,
+        m_levelDescription,
+        m_levelGeneration,
+        m_savedPositionsRingBuffer,
+        m_gameState,
+        m_livesRemaining,
+        m_respawnCountdown,
+        m_scheduler,
+        m_menu,
+        m_random,
+    };
+    for (const auto& shape : m_allDynamicGameShapes) {
+        if (isStaticShape(*shape)) {
+            snapshot.staticShapesActive.push_back(shape->IsActive());
+        } else {
+            snapshot.shapeStates.push_back(*shape);
+        }
+    }
+    return snapshot;
+}
+
+void GameModel::restore(const GameModelSnapshot& snapshot)
+{
+    // The shapes themselves are shared with the snapshot, so are put back
+    // as they were, rather than replaced
+    m_allDynamicGameShapes = snapshot.shapes;
+    size_t shapeState = 0;
+    size_t staticShape = 0;
+    for (const auto& shape : m_allDynamicGameShapes) {
+        if (isStaticShape(*shape)) {
+            shape->setIsActive(snapshot.staticShapesActive[staticShape++]);
+        } else {
+            *shape = snapshot.shapeStates[shapeState++];
+        }
+    }
+    // The ship's shapes are among those just restored
+    m_shipModel = std::make_unique<ShipModel>(*snapshot.shipModel);
+    m_breakableExplosionShape = snapshot.breakableExplosionShape;
+    m_breakableExploding = snapshot.breakableExploding;
+    m_levelFileName = snapshot.levelFileName;
+    m_levelDescription = snapshot.levelDescription;
+    m_savedPositionsRingBuffer = snapshot.savedPositions;
+    m_gameState = snapshot.gameState;
+    m_livesRemaining = snapshot.livesRemaining;
+    m_respawnCountdown = snapshot.respawnCountdown;
+    m_scheduler = snapshot.scheduler;
+    m_menu = snapshot.menu;
+    m_random = snapshot.random;
+
+    // Within a Level, only destroyed breakables can have come back, so the
+    // collision index is just refitted, and the distance field rebuilt only
+    // if they have; a different Level needs everything rebuilding
+    if (snapshot.levelGeneration != m_levelGeneration) {
+        m_staticGeometry.build(m_allDynamicGameShapes);
+        m_distanceField.build(m_allDynamicGameShapes);
+        m_occupancyGrid.build(m_allDynamicGameShapes);
+        m_levelGeneration = snapshot.levelGeneration;
+    } else {
+        m_staticGeometry.refit();
+        if (!m_distanceField.isUpToDate(m_allDynamicGameShapes)) {
+            m_distanceField.build(m_allDynamicGameShapes);
+        }
+    }
+    // Not the snapshot's version number, as the View may have seen that
+    // number with different shapes
+    ++m_staticShapesVersion;
+    saveStepStart();
+}
+
 void GameModel::savePosition()
 {
     if (m_gameState == GameState::Exploding) {
@@ -444,8 +691,7 @@ void GameModel::savePosition()
     unsigned x = static_cast<unsigned int>(m_shipModel->x());
     unsigned y = static_cast<unsigned int>(m_shipModel->y());
     double rot = m_shipModel->rotation();
-    // The ring buffer has 200 slots, so at 100 fps the last
-    // item in the buffer will be from about two seconds ago
+    // The last item in the buffer will be from about savedPositionsSeconds ago
     m_savedPositionsRingBuffer.add({ x, y, rot });
 }
 
@@ -472,10 +718,9 @@ void GameModel::restart()
     m_shipModel->setShipY(m_savedPositionsRingBuffer.lastItem().posY);
     m_shipModel->setRotation(m_savedPositionsRingBuffer.lastItem().rotation);
     m_shipModel->setVisible(true);
-    m_gameState = GameState::Running;
+    m_gameState = GameState::Respawning;
     m_shipModel->buildExplosionShape();
-
-    std::this_thread::sleep_for(std::chrono::seconds(2));
+    saveStepStart();
 }
 
 GameState GameModel::getGameState()
@@ -512,6 +757,21 @@ void GameModel::setBreakableExploding(bool value /* =true */)
     m_breakableExplosionShape->setVisible(value);
 }
 
+void GameModel::setRandomSeed(uint32_t seed)
+{
+    m_random.seed(seed);
+}
+
+void GameModel::setRespawnCountdown(int seconds)
+{
+    m_respawnCountdown = seconds;
+}
+
+int GameModel::getRespawnCountdown() const
+{
+    return m_respawnCountdown;
+}
+
 void GameModel::resetMenuPosition()
 {
     m_menu.resetMenuPosition();
@@ -554,8 +814,7 @@ void GameModel::rebuildShip()
         }
     }
     m_shipModel.reset();
-    m_shipModel
-        = std::make_unique<ShipModel>(ShipModel(newGameShape(), newGameShape(), newGameShape()));
+    m_shipModel = newShipModel();
 }
 
 } // namespace amaze
@@ -1,14 +1,19 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
+#include <vector>
 
+#include "distancefield.h"
 #include "gameshape.h"
 #include "imodel.h"
 #include "menu.h"
+#include "occupancygrid.h"
 #include "scheduler.h"
 #include "shipmodel.h"
+#include "staticgeometry.h"
 #include "utils.h"
 
 // This class acts as the MVC "model" for the game.
@@ -32,6 +37,7 @@ enum class GameState {
     Dead, // life is lost
     Succeeded, // found the exit
     Paused, // game is paused
+    Respawning, // counting down before a new ship starts, after a life is lost
     Quit, // user requested to quit
     Menu // Level selection / options etc
 };
@@ -42,10 +48,49 @@ struct ShipPosition {
     double rotation;
 };
 
+// One of the shapes which can collide with things (the ship or its flames)
+// touching another shape
+struct Contact {
+    GameShapeType probeType; // SHIP or FLAMES
+    std::shared_ptr<GameShape> shape;
+    // Set if the ship hit this during its movement since the last frame,
+    // see ShipModel::rewindPosition()
+    std::optional<double> timeOfImpact;
+};
+
+// Everything in a GameModel which changes during play, so that it can be put
+// back as it was (see GameModel::snapshot())
+struct GameModelSnapshot {
+    std::vector<std::shared_ptr<GameShape>> shapes;
+    // Static shapes only ever change by being deactivated, so just that is
+    // kept for them, and a full copy of each of the rest
+    std::vector<GameShape> shapeStates; // one per non-static shape
+    std::vector<bool> staticShapesActive; // one per static shape
+    std::optional<ShipModel> shipModel;
+    std::shared_ptr<GameShape> breakableExplosionShape;
+    bool breakableExploding;
+    std::string levelFileName;
+    std::string levelDescription;
+    unsigned levelGeneration;
+    utils::RingBuffer<ShipPosition> savedPositions;
+    GameState gameState;
+    int livesRemaining;
+    int respawnCountdown;
+    Scheduler scheduler;
+    Menu menu;
+    utils::Random random;
+};
+
 class GameModel final : public IModel {
 public:
     explicit GameModel(const std::string& dataPath);
 
+    // The game's speeds, accelerations and timings are tuned for this many
+    // simulation steps per second, and scaled to suit the actual tick rate
+    static constexpr unsigned referenceTickRate = 100;
+    // Simulation steps per second. Call this before loading a Level.
+    void setTickRate(unsigned ticksPerSecond);
+
     // Reset the model to a state ready for a new Level:
     void initialise(const std::string& levelFileName);
     void levelLoad(size_t levelNum);
@@ -66,9 +111,41 @@ public:
     // Returns a non-owning pointer to the ship model
     ShipModel* getShipModel() const;
 
-    std::tuple<GameShapeType, std::shared_ptr<GameShape>> collisionDetect() const;
+    // Fills "contacts" (which is cleared first) with everything the ship and
+    // flames are touching. Contacts are in the order the shapes were loaded,
+    // and a ship contact comes before a flames contact with the same shape.
+    void collisionDetect(std::vector<Contact>& contacts) const;
+    // If enabled, collisionDetect() also checks the path the ship took since
+    // the last frame against static Level geometry, so it can't pass through a
+    // wall however fast it's going
+    void setContinuousCollision(bool value);
+    bool continuousCollision() const;
+    // Distance from anywhere to the Level's walls, for proximity warnings etc.
+    const DistanceField& distanceField() const;
+    // How close the ship is to a wall, from 0.0 (nowhere near) to 1.0 (touching)
+    double shipProximity() const;
+    void setDistanceFieldCacheDirectory(const std::string& directory);
+    // Use this rather than GameShape::setIsActive(false) so the shape is also
+    // removed from the static collision index
+    void deactivateShape(const std::shared_ptr<GameShape>& shape);
+    // Static shapes are those which never move or change (other than being
+    // deactivated), e.g. walls
+    static bool isStaticShape(const GameShape& shape);
+    // Changes whenever the set of active static shapes does
+    unsigned staticShapesVersion() const;
+    // Changes whenever the shapes themselves do, i.e. a different Level load.
+    // Within one, static shapes only change by being (de)activated.
+    unsigned levelGeneration() const;
 
     void process();
+    // Called at the start of each simulation step, so that the View can draw
+    // things part way between steps
+    void saveStepStart();
+    // Used to jump back (or forward) through a replay. Restoring a snapshot
+    // from a different Level load rebuilds the collision indexes, so costs
+    // as much as loading the Level did.
+    GameModelSnapshot snapshot() const;
+    void restore(const GameModelSnapshot& snapshot);
     std::vector<std::shared_ptr<GameShape>> getAllDynamicObjects();
 
     unsigned int getRotation() const override;
@@ -76,6 +153,8 @@ public:
     void savePosition();
     void togglePause();
     bool gameIsPaused(); // returns true if paused
+    // Puts a new ship where the last one was a couple of seconds before it
+    // was lost, ready to respawn
     void restart();
     GameState getGameState();
     void setGameState(GameState state);
@@ -83,6 +162,12 @@ public:
     void extraLife();
     void setLives(int lives);
     void setBreakableExploding(bool value = true);
+    // Given the same seed and input, the simulation runs identically. Takes
+    // effect from the next Level load.
+    void setRandomSeed(uint32_t seed);
+    // Whole seconds left before play starts, while Respawning
+    void setRespawnCountdown(int seconds);
+    int getRespawnCountdown() const;
     int getLivesRemaining()
     {
         return m_livesRemaining;
@@ -110,18 +195,43 @@ private:
     // Container for all GameShapes in the game:
     std::vector<std::shared_ptr<GameShape>> m_allDynamicGameShapes;
 
+    // Index over the Level's non-moving shapes, used by collisionDetect()
+    StaticGeometry m_staticGeometry;
+    mutable std::vector<ProbeHit> m_staticHits;
+    mutable std::vector<SweepHit> m_sweepHits;
+    // Lets collisionDetect() skip m_staticGeometry when nothing is nearby
+    OccupancyGrid m_occupancyGrid;
+    DistanceField m_distanceField;
+    unsigned m_staticShapesVersion { 0 };
+    unsigned m_levelGeneration { 0 }; // changes every Level load
+    unsigned m_levelLoads { 0 };
+    bool m_continuousCollision { false };
+    unsigned m_tickRate { referenceTickRate };
+    double m_stepScale { 1.0 }; // reference steps per simulation step
+
     std::unique_ptr<ShipModel> m_shipModel;
 
     size_t m_averageFrameTime { 0 };
     std::shared_ptr<GameShape> m_breakableExplosionShape;
     bool m_breakableExploding { false };
 
-    utils::RingBuffer<ShipPosition, 200> m_savedPositionsRingBuffer;
+    // Where the ship was over the last savedPositionsSeconds, so it can be
+    // put back somewhere safe after exploding
+    static constexpr unsigned savedPositionsSeconds = 2;
+    utils::RingBuffer<ShipPosition> m_savedPositionsRingBuffer {
+        savedPositionsSeconds * referenceTickRate
+    };
     GameState m_gameState { GameState::Running };
     void rebuildShip();
+    std::unique_ptr<ShipModel> newShipModel();
+    // The number of simulation steps in "seconds"
+    int steps(double seconds) const;
     int m_livesRemaining { 1 };
+    int m_respawnCountdown { 0 };
     Scheduler m_scheduler;
     Menu m_menu;
+    // Only for the simulation, so that it's repeatable
+    utils::Random m_random;
 };
 
 } // namespace amaze
@@ -35,7 +35,7 @@ void GameShape::setName(const std::string& name)
     m_name = name;
 }
 
-void GameShape::move()
+void GameShape::move(double stepScale)
 {
     if (!m_originalX.has_value()) {
         m_originalX = getPosX();
@@ -56,10 +56,10 @@ void GameShape::move()
     if (getPosY() < *m_originalY - m_yMaxDifference) {
         m_yDelta = -m_yDelta;
     }
-    setPos(getPosX() + m_xDelta, getPosY() + m_yDelta);
+    setPos(getPosX() + m_xDelta * stepScale, getPosY() + m_yDelta * stepScale);
 
     if (m_rotationDelta != 0.0f) {
-        rotate(m_rotationDelta);
+        rotate(m_rotationDelta * stepScale);
     }
 }
 
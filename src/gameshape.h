@@ -40,7 +40,9 @@ public:
     void setName(const std::string& name);
 
     // The following are only used for moving objects
-    void move();
+    // Moves (and rotates) by its deltas, which are per reference step, times
+    // "stepScale" (see GameModel::setTickRate())
+    void move(double stepScale);
     float getRotationDelta() const;
     void setRotationDelta(float value);
     float getXDelta() const;
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <functional>
 #include <optional>
+#include <span>
 
 // Defines an adapter interface for the graphical toolkit
 // in use (currently SfmlAdapter implements this)
@@ -37,6 +38,52 @@ struct Text {
     std::optional<float> positionY; // no value means centered in Y
 };
 
+// One line for drawLines(), in screen coordinates
+struct LineInstance {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    float width;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+// A line already expanded to the four corners of the rectangle it covers (in
+// screen coordinates, in order around the rectangle), so that it needs no
+// more work before being drawn
+struct LineQuad {
+    float x[4];
+    float y[4];
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+// Maps world coordinates to the screen: the world is translated so that
+// (centreX, centreY) is at the origin, rotated (in degrees), scaled, and
+// finally offset
+struct Camera {
+    double centreX;
+    double centreY;
+    double rotation;
+    double scale;
+    double offsetX;
+    double offsetY;
+};
+
+// Evenly spaced horizontal and vertical lines, in world coordinates, every
+// "spacing" units from 0 to "extent" in each direction
+struct Grid {
+    double spacing;
+    double extent;
+    double lineWidth; // in world units
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
 class IGraphicsAdapter {
 public:
     // TODO - make all functions const where possible
@@ -47,6 +94,25 @@ public:
     virtual int setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) = 0;
     virtual void drawLine(int xFrom, int yFrom, int xTo, int yTo, int width, int r, int g, int b)
         = 0;
+    // Draws many lines at once, which is far cheaper than calling drawLine()
+    // for each of them
+    virtual void drawLines(std::span<const LineInstance> lines) = 0;
+    virtual void drawLineQuads(std::span<const LineQuad> quads) = 0;
+    // Lines which never change (e.g. Level walls) can be given once, in world
+    // coordinates (and with widths in world units), and then drawn each frame
+    // through a camera without being transformed or sent again
+    virtual void setStaticLines(std::span<const LineInstance> lines) = 0;
+    // Hides (or shows again) some of the lines given to setStaticLines(), e.g.
+    // a destroyed breakable's, without sending them all again
+    virtual void setStaticLinesShown(size_t first, size_t count, bool shown) = 0;
+    virtual void drawStaticLines(const Camera& camera) = 0;
+    // Draws the whole grid in one go, however many lines it has
+    virtual void drawGrid(const Grid& grid, const Camera& camera) = 0;
+    // Keeps a copy of everything drawn so far this frame, with its brightness
+    // scaled (0 to 1), and replaces what's been drawn with it. Afterwards
+    // drawBackdrop() draws the copy again, for the cost of one image.
+    virtual void captureBackdrop(float brightness) = 0;
+    virtual void drawBackdrop() = 0;
     virtual int getWindoWidth() const = 0;
     virtual int getWindowHeight() const = 0;
     virtual int getTicks() const = 0;
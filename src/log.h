@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cerrno>
 #include <chrono>
 #include <cstring>
@@ -63,7 +64,7 @@ public:
                 "mgo::Log: cannot open '{}': {}", filename, std::strerror(errno)) };
         }
 
-        instance.m_min_level = min_level;
+        instance.m_min_level.store(min_level, std::memory_order_relaxed);
     }
 
     // User-callable log functions
@@ -104,11 +105,12 @@ private:
         const std::source_location loc = std::source_location::current())
     {
         auto& instance = get_instance();
-        std::scoped_lock lock { instance.m_mtx };
-
-        if (level < instance.m_min_level) {
+        // Checked before taking the lock, so that filtered-out messages cost
+        // (almost) nothing, however many threads are logging
+        if (level < instance.m_min_level.load(std::memory_order_relaxed)) {
             return;
         }
+        std::scoped_lock lock { instance.m_mtx };
 
         const auto entry = std::format(
             "{}|{}|{}:{}|{}\n",
@@ -181,7 +183,7 @@ private:
     }
 
     std::ofstream m_ofs;
-    Level m_min_level { Level::Debug };
+    std::atomic<Level> m_min_level { Level::Debug };
     std::mutex m_mtx;
 };
 
@@ -1,15 +1,24 @@
 #include "sfmladapter.h"
 
+#include "batchrunner.h"
 #include "configreader.h"
 #include "controller.h"
 #include "exceptions.h"
 #include "log.h"
+#include "nullgraphicsadapter.h"
 #include "programoptions.h"
+#include "replay.h"
 #include "view.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <format>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
 
 // MVC intentions
 // What goes where in the MVC pattern can be a matter for debate; here's
@@ -31,6 +40,42 @@
 // related to the mechanics of the game BUT NOT logic related to actual
 // gameplay (which should be in the model).
 
+namespace {
+
+// Default length of a --headless run, if --frames isn't given
+constexpr uint64_t headlessFrames = 1000;
+
+void printHeadlessReport(
+    const marengo::amaze::PhaseTimings& timings,
+    const marengo::amaze::NullGraphicsCounters& counters,
+    const marengo::amaze::RenderStats& renderStats,
+    std::chrono::nanoseconds elapsed)
+{
+    using namespace std::chrono;
+    double seconds = duration<double>(elapsed).count();
+    std::cout << std::format(
+        "{} frames ({} simulation steps) in {:.3f}s: {:.0f} frames per second\n",
+        timings.frames,
+        timings.steps,
+        seconds,
+        seconds > 0.0 ? timings.frames / seconds : 0.0);
+    std::cout << marengo::amaze::formatPhaseTimings(timings);
+    std::cout << std::format(
+        "{} draw calls, {} lines, {} static lines, {} texts\n",
+        counters.drawCalls,
+        counters.linesDrawn,
+        counters.staticLinesDrawn,
+        counters.textsDrawn);
+    std::cout << std::format(
+        "Last frame: {} lines drawn, {} lines ({} shapes) culled, {} static lines\n",
+        renderStats.linesDrawn,
+        renderStats.linesCulled,
+        renderStats.shapesCulled,
+        renderStats.staticLines);
+}
+
+} // namespace
+
 int main(int argc, char* argv[])
 {
     using namespace marengo::amaze;
@@ -81,7 +126,13 @@ int main(int argc, char* argv[])
         if (programOptions.cmdOptionExists("-h") || programOptions.cmdOptionExists("--help")) {
             std::cout
                 << "Usage: amaze [-h|--help] [-f|--fullscreen] [-w|--windowed] [--file <level "
-                   "FILE>] [-l <level number>]"
+                   "FILE>] [-l|--level <level number>]\n"
+                   "       amaze --headless [--file <level FILE>] [-l|--level <level number>] "
+                   "[--frames <count>] [--input <input script>] [--seed <seed>]\n"
+                   "Either may also have [--record <replay FILE>] or [--replay <replay FILE>]\n"
+                   "A replay may be sped up with [--replay-speed <times faster|max>] and start "
+                   "part way through with [--seek <step>]\n"
+                   "       amaze --batch <jobs FILE> [--threads <count>]"
                 << std::endl;
             return 0;
         }
@@ -93,12 +144,14 @@ int main(int argc, char* argv[])
             useFullScreen = false;
         }
         int gameLevel = config.readLong("GameLevel", 0);
-        if (programOptions.cmdOptionExists("-l")) {
-            int level;
-            try {
-                level = std::atoi(programOptions.getCmdOption("-l").c_str());
-                gameLevel = level;
-            } catch (...) {
+        for (const char* option : { "-l", "--level" }) {
+            if (programOptions.cmdOptionExists(option)) {
+                int level;
+                try {
+                    level = std::atoi(programOptions.getCmdOption(option).c_str());
+                    gameLevel = level;
+                } catch (...) {
+                }
             }
         }
         // Specify a level FILE to load
@@ -107,13 +160,121 @@ int main(int argc, char* argv[])
             levelFile = programOptions.getCmdOption("--file");
         }
 
-        SfmlAdapter graphicsManager(width, height, useFullScreen, dataDir);
+        // Many headless games at once, e.g. to check every Level still plays
+        // as its replay says it should
+        if (programOptions.cmdOptionExists("--batch")) {
+            BatchSettings settings;
+            settings.dataDir = dataDir;
+            settings.screenWidth = width;
+            settings.screenHeight = height;
+            settings.continuousCollision = config.readBool("ContinuousCollision", false);
+            settings.distanceFieldCache = config.read("DistanceFieldCache", "");
+            settings.tickRate = config.readLong("TickRate", 100);
+            settings.defaultFrames = headlessFrames;
+            if (programOptions.cmdOptionExists("--threads")) {
+                settings.threads = std::stoul(programOptions.getCmdOption("--threads"));
+            }
+            auto jobs = loadBatchJobs(programOptions.getCmdOption("--batch"));
+            auto start = std::chrono::steady_clock::now();
+            auto results = runBatch(jobs, settings);
+            printBatchReport(jobs, results, std::chrono::steady_clock::now() - start);
+            bool failed = std::any_of(results.begin(), results.end(), [](const BatchResult& r) {
+                return !r.error.empty();
+            });
+            return failed ? 1 : 0;
+        }
+
+        // A replay's Level and seed override everything else
+        std::optional<Replay> replay;
+        if (programOptions.cmdOptionExists("--replay")) {
+            replay = loadReplay(programOptions.getCmdOption("--replay"));
+            gameLevel = replay->gameLevel;
+            levelFile = replay->levelFile;
+        }
+        std::string recordFile = programOptions.getCmdOption("--record");
+
+        // Headless runs have no window (or sound, or controller), and run as
+        // fast as they can, to measure how much CPU time the game needs
+        bool headless = programOptions.cmdOptionExists("--headless");
+        std::unique_ptr<IGraphicsAdapter> graphicsAdapter;
+        NullGraphicsAdapter* nullGraphicsAdapter = nullptr;
+        if (headless) {
+            auto adapter = std::make_unique<NullGraphicsAdapter>(width, height);
+            if (programOptions.cmdOptionExists("--input")) {
+                adapter->setInputScript(loadInputScript(programOptions.getCmdOption("--input")));
+            }
+            nullGraphicsAdapter = adapter.get();
+            graphicsAdapter = std::move(adapter);
+        } else {
+            graphicsAdapter
+                = std::make_unique<SfmlAdapter>(width, height, useFullScreen, dataDir);
+        }
+        IGraphicsAdapter& graphicsManager = *graphicsAdapter;
 
         GameModel gameModel(dataDir);
+        // Zero for a different game every time, except that headless runs
+        // should be repeatable
+        uint32_t seed = config.readLong("RandomSeed", 0);
+        if (programOptions.cmdOptionExists("--seed")) {
+            seed = std::stoul(programOptions.getCmdOption("--seed"));
+        } else if (headless && seed == 0) {
+            seed = 1;
+        }
+        if (replay) {
+            seed = replay->seed;
+        }
+        // A recording can only be replayed if we know its seed
+        while (!recordFile.empty() && seed == 0) {
+            seed = std::random_device {}();
+        }
+        if (seed != 0) {
+            gameModel.setRandomSeed(seed);
+        }
+        gameModel.setContinuousCollision(config.readBool("ContinuousCollision", false));
+        gameModel.setDistanceFieldCacheDirectory(config.read("DistanceFieldCache", ""));
         View view(gameModel, graphicsManager);
 
         Controller controller(gameModel, view, graphicsManager);
+        controller.setTickRate(config.readLong("TickRate", 100));
+        controller.setFrameRate(config.readLong("FrameRate", 100));
+        controller.setMaxCatchUpSteps(config.readLong("MaxCatchUpSteps", 5));
+        if (replay) {
+            controller.playReplay(std::move(*replay));
+            if (programOptions.cmdOptionExists("--replay-speed")) {
+                std::string speed = programOptions.getCmdOption("--replay-speed");
+                controller.setReplaySpeed(speed == "max" ? 0.0 : std::stod(speed));
+            }
+            if (programOptions.cmdOptionExists("--seek")) {
+                controller.seekReplay(std::stoul(programOptions.getCmdOption("--seek")));
+            }
+        }
+        if (!recordFile.empty()) {
+            Replay recording;
+            recording.seed = seed;
+            recording.gameLevel = gameLevel;
+            recording.levelFile = levelFile;
+            controller.recordReplay(std::move(recording));
+        }
+        if (headless) {
+            // Replays end by themselves
+            uint64_t frames = replay ? 0 : headlessFrames;
+            if (programOptions.cmdOptionExists("--frames")) {
+                frames = std::stoull(programOptions.getCmdOption("--frames"));
+            }
+            controller.setFrameLimit(frames);
+        }
+        auto start = std::chrono::steady_clock::now();
         controller.mainLoop(gameLevel, levelFile);
+        if (controller.recording()) {
+            saveReplay(recordFile, *controller.recording());
+        }
+        if (headless) {
+            printHeadlessReport(
+                controller.phaseTimings(),
+                nullGraphicsAdapter->counters(),
+                view.renderStats(),
+                std::chrono::steady_clock::now() - start);
+        }
 
         // TODO model.preferencesSave();
 
@@ -0,0 +1,393 @@
+#include "nullgraphicsadapter.h"
+#include "exceptions.h"
+
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace marengo {
+namespace amaze {
+
+namespace {
+
+const std::unordered_map<std::string, KeyControls> controlNames {
+    { "LEFT", KeyControls::LEFT },
+    { "RIGHT", KeyControls::RIGHT },
+    { "ACCELERATE", KeyControls::ACCELERATE },
+    { "QUIT", KeyControls::QUIT },
+    { "LR_ANALOGUE", KeyControls::LR_ANALOGUE },
+    { "PAUSE", KeyControls::PAUSE },
+    { "MENU", KeyControls::MENU },
+    { "UP", KeyControls::UP },
+    { "DOWN", KeyControls::DOWN },
+    { "ENTER", KeyControls::ENTER },
+    { "EXIT", KeyControls::EXIT },
+};
+
+bool isMenuControl(KeyControls key)
+{
+    return key == KeyControls::UP || key == KeyControls::DOWN || key == KeyControls::ENTER
+        || key == KeyControls::EXIT;
+}
+
+bool worksWhilePaused(KeyControls key)
+{
+    return key == KeyControls::PAUSE || key == KeyControls::MENU || key == KeyControls::QUIT;
+}
+
+} // anonymous namespace
+
+std::vector<InputEvent> loadInputScript(const std::string& fileName)
+{
+    std::ifstream ifs(fileName);
+    if (!ifs) {
+        THROWUP(AmazeRuntimeException, std::format("Could not open input script {}", fileName));
+    }
+    std::vector<InputEvent> script;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(ifs, line)) {
+        ++lineNumber;
+        std::istringstream iss(line);
+        std::string first;
+        if (!(iss >> first) || first[0] == '#') {
+            continue;
+        }
+        InputEvent event { 0, KeyControls::NONE, false, 0.f };
+        std::string control;
+        std::string direction;
+        try {
+            event.frame = std::stoull(first);
+        } catch (const std::exception&) {
+            THROWUP(
+                AmazeRuntimeException,
+                std::format("Bad frame number in {} line {}", fileName, lineNumber));
+        }
+        iss >> control >> direction;
+        auto it = controlNames.find(control);
+        if (it == controlNames.end() || (direction != "down" && direction != "up")) {
+            THROWUP(
+                AmazeRuntimeException,
+                std::format("Bad input event in {} line {}", fileName, lineNumber));
+        }
+        event.key = it->second;
+        event.isKeyDown = direction == "down";
+        iss >> event.value;
+        if (!script.empty() && event.frame < script.back().frame) {
+            THROWUP(
+                AmazeRuntimeException,
+                std::format("Input events out of order in {} line {}", fileName, lineNumber));
+        }
+        script.push_back(event);
+    }
+    return script;
+}
+
+NullGraphicsAdapter::NullGraphicsAdapter(unsigned screenWidth, unsigned screenHeight)
+    : m_screenWidth(screenWidth)
+    , m_screenHeight(screenHeight)
+{
+}
+
+void NullGraphicsAdapter::setInputScript(std::vector<InputEvent> script)
+{
+    m_script = std::move(script);
+    m_nextEvent = 0;
+    m_heldEvents.clear();
+}
+
+const NullGraphicsCounters& NullGraphicsAdapter::counters() const
+{
+    return m_counters;
+}
+
+void NullGraphicsAdapter::setRecording(bool enabled)
+{
+    m_recording = enabled;
+}
+
+const std::vector<std::string>& NullGraphicsAdapter::recording() const
+{
+    return m_recordingEntries;
+}
+
+const InputEvent* NullGraphicsAdapter::nextEvent()
+{
+    if (m_nextEvent < m_script.size() && m_script[m_nextEvent].frame <= m_counters.frames) {
+        return &m_script[m_nextEvent++];
+    }
+    return nullptr;
+}
+
+void NullGraphicsAdapter::setFrameRate(unsigned int fr)
+{
+    m_frameRate = fr;
+}
+
+void NullGraphicsAdapter::cls()
+{
+    record("cls");
+}
+
+void NullGraphicsAdapter::redraw()
+{
+    // Nothing to wait for: the next frame starts immediately
+    record("redraw");
+    ++m_counters.frames;
+}
+
+int NullGraphicsAdapter::setDrawColour(
+    uint8_t, // r
+    uint8_t, // g
+    uint8_t, // b
+    uint8_t // a
+)
+{
+    return 0;
+}
+
+void NullGraphicsAdapter::drawLine(
+    int, // xFrom
+    int, // yFrom
+    int, // xTo
+    int, // yTo
+    int, // width
+    int, // r
+    int, // g
+    int // b
+)
+{
+    ++m_counters.drawCalls;
+    ++m_counters.linesDrawn;
+    record("drawLine");
+}
+
+void NullGraphicsAdapter::drawLines(std::span<const LineInstance> lines)
+{
+    if (lines.empty()) {
+        return;
+    }
+    ++m_counters.drawCalls;
+    m_counters.linesDrawn += lines.size();
+    record("drawLines {}", lines.size());
+}
+
+void NullGraphicsAdapter::drawLineQuads(std::span<const LineQuad> quads)
+{
+    if (quads.empty()) {
+        return;
+    }
+    ++m_counters.drawCalls;
+    m_counters.linesDrawn += quads.size();
+    record("drawLineQuads {}", quads.size());
+}
+
+void NullGraphicsAdapter::setStaticLines(std::span<const LineInstance> lines)
+{
+    m_staticLinesShown.assign(lines.size(), true);
+    m_staticLineCount = lines.size();
+    record("setStaticLines {}", lines.size());
+}
+
+void NullGraphicsAdapter::setStaticLinesShown(size_t first, size_t count, bool shown)
+{
+    for (size_t n = first; n < first + count && n < m_staticLinesShown.size(); ++n) {
+        if (m_staticLinesShown[n] == shown) {
+            continue;
+        }
+        m_staticLinesShown[n] = shown;
+        if (shown) {
+            ++m_staticLineCount;
+        } else {
+            --m_staticLineCount;
+        }
+    }
+    record("setStaticLinesShown {} {} {}", first, count, shown);
+}
+
+void NullGraphicsAdapter::drawStaticLines(const Camera&)
+{
+    ++m_counters.drawCalls;
+    m_counters.staticLinesDrawn += m_staticLineCount;
+    record("drawStaticLines");
+}
+
+void NullGraphicsAdapter::drawGrid(const Grid&, const Camera&)
+{
+    ++m_counters.drawCalls;
+    record("drawGrid");
+}
+
+void NullGraphicsAdapter::captureBackdrop(float brightness)
+{
+    ++m_counters.drawCalls;
+    record("captureBackdrop {}", brightness);
+}
+
+void NullGraphicsAdapter::drawBackdrop()
+{
+    ++m_counters.drawCalls;
+    record("drawBackdrop");
+}
+
+int NullGraphicsAdapter::getWindoWidth() const
+{
+    return m_screenWidth;
+}
+
+int NullGraphicsAdapter::getWindowHeight() const
+{
+    return m_screenHeight;
+}
+
+int NullGraphicsAdapter::getTicks() const
+{
+    // Time as it would have been had every frame taken exactly as long as
+    // the frame rate allows
+    if (m_frameRate == 0) {
+        return 0;
+    }
+    return static_cast<int>(m_counters.frames * 1000 / m_frameRate);
+}
+
+void NullGraphicsAdapter::imageDisplay(
+    const std::string&, // fileName,
+    int, // x,
+    int // y
+)
+{
+}
+
+size_t NullGraphicsAdapter::imageLoad(const std::string& /* fileName */)
+{
+    return 0;
+}
+
+void NullGraphicsAdapter::imageDisplay(
+    size_t, // id,
+    int, // x,
+    int // y
+)
+{
+}
+
+void NullGraphicsAdapter::imageUnload(size_t /* id */) { }
+
+void NullGraphicsAdapter::drawStatusBar()
+{
+    ++m_counters.drawCalls;
+    record("drawStatusBar");
+}
+
+void NullGraphicsAdapter::drawText(const Text& text)
+{
+    ++m_counters.drawCalls;
+    ++m_counters.textsDrawn;
+    record("drawText {}", text.text);
+}
+
+void NullGraphicsAdapter::drawMenu(std::vector<MenuItem> menuItems, int currentlyHighlightedItem)
+{
+    if (menuItems.empty()) {
+        return;
+    }
+    // As SfmlAdapter: the menu's name, then each of its items
+    m_counters.drawCalls += menuItems.size() + 1;
+    m_counters.textsDrawn += menuItems.size() + 1;
+    record("drawMenu {} {}", menuItems[0].menuName, currentlyHighlightedItem);
+}
+
+void NullGraphicsAdapter::registerControlHandler(
+    KeyControls key,
+    std::function<void(const bool, const float)> controlHandler)
+{
+    m_controlHandlers[key] = controlHandler;
+}
+
+void NullGraphicsAdapter::processInput(bool paused)
+{
+    // Delivers every event due by this frame. As with the keyboard, only
+    // pausing, the menu, quitting and releasing keys work while paused. Other
+    // presses (and analogue values) are held, as if the key were still down,
+    // and delivered once we're not paused; only the latest for each control
+    // is kept.
+    if (!paused) {
+        for (const auto& event : m_heldEvents) {
+            deliver(event);
+        }
+        m_heldEvents.clear();
+    }
+    while (const InputEvent* event = nextEvent()) {
+        bool isPress = event->isKeyDown || event->key == KeyControls::LR_ANALOGUE;
+        std::erase_if(m_heldEvents, [&](const InputEvent& held) { return held.key == event->key; });
+        if (paused && isPress && !worksWhilePaused(event->key)) {
+            m_heldEvents.push_back(*event);
+            continue;
+        }
+        deliver(*event);
+    }
+}
+
+void NullGraphicsAdapter::deliver(const InputEvent& event)
+{
+    auto it = m_controlHandlers.find(event.key);
+    if (it != m_controlHandlers.end()) {
+        record("input {} {}", static_cast<int>(event.key), event.value);
+        it->second(event.isKeyDown, event.value);
+    }
+}
+
+KeyControls NullGraphicsAdapter::processMenuInput()
+{
+    // Only one event is returned per call; anything other than a menu key
+    // is ignored
+    while (const InputEvent* event = nextEvent()) {
+        if (event->isKeyDown && isMenuControl(event->key)) {
+            record("menuInput {}", static_cast<int>(event->key));
+            return event->key;
+        }
+    }
+    return KeyControls::NONE;
+}
+
+void NullGraphicsAdapter::soundLoad(const std::string&, const std::string&) { }
+
+void NullGraphicsAdapter::soundPlay(const std::string& key)
+{
+    ++m_counters.soundEvents;
+    record("soundPlay {}", key);
+}
+
+void NullGraphicsAdapter::soundLoop(const std::string& key, float volume)
+{
+    ++m_counters.soundEvents;
+    record("soundLoop {} {}", key, volume);
+}
+
+void NullGraphicsAdapter::soundFade(const std::string& key, const int msecs)
+{
+    ++m_counters.soundEvents;
+    record("soundFade {} {}", key, msecs);
+}
+
+void NullGraphicsAdapter::musicLoad(const std::string&) { }
+
+void NullGraphicsAdapter::musicPlayLoop() { }
+
+void NullGraphicsAdapter::rumble(
+    uint16_t lowFreqIntensity,
+    uint16_t highFreqIntensity,
+    uint32_t durationMs)
+{
+    ++m_counters.rumbles;
+    record("rumble {} {} {}", lowFreqIntensity, highFreqIntensity, durationMs);
+}
+
+float NullGraphicsAdapter::getScalingFactor()
+{
+    return m_screenHeight / 1080.f;
+}
+
+} // namespace amaze
+} // namespace marengo
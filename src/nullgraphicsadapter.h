@@ -0,0 +1,128 @@
+#pragma once
+
+// A graphics adapter which doesn't display (or play) anything, so needs no
+// window, audio device or game controller. It counts what would have been
+// drawn and played, optionally keeping a log of every call, and its input
+// comes from a script. Its clock only advances by one frame per redraw(), so
+// a scripted run gives the same results every time.
+
+#include "igraphicsadapter.h"
+#include "menu.h"
+
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace marengo {
+namespace amaze {
+
+// A scripted key press / release (or analogue value), delivered at the start
+// of the given frame
+struct InputEvent {
+    uint64_t frame;
+    KeyControls key;
+    bool isKeyDown;
+    float value;
+};
+
+// Reads an input script. Each line is "<frame> <control> <down|up> [value]",
+// e.g. "120 ACCELERATE down 25", where control is one of the KeyControls
+// names; lines starting with # are comments.
+std::vector<InputEvent> loadInputScript(const std::string& fileName);
+
+struct NullGraphicsCounters {
+    uint64_t frames { 0 };
+    uint64_t drawCalls { 0 };
+    uint64_t linesDrawn { 0 };
+    uint64_t staticLinesDrawn { 0 };
+    uint64_t textsDrawn { 0 };
+    uint64_t soundEvents { 0 };
+    uint64_t rumbles { 0 };
+};
+
+class NullGraphicsAdapter final : public IGraphicsAdapter {
+
+public:
+    NullGraphicsAdapter(unsigned screenWidth, unsigned screenHeight);
+    // Events must be in frame order
+    void setInputScript(std::vector<InputEvent> script);
+    const NullGraphicsCounters& counters() const;
+    // If enabled, every call is logged (one line each) to recording()
+    void setRecording(bool enabled);
+    const std::vector<std::string>& recording() const;
+
+    virtual void setFrameRate(unsigned int fr) override;
+    virtual void cls() override;
+    virtual void redraw() override;
+    virtual int setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) override;
+    virtual void
+    drawLine(int xFrom, int yFrom, int xTo, int yTo, int width, int r, int g, int b) override;
+    virtual void drawLines(std::span<const LineInstance> lines) override;
+    virtual void drawLineQuads(std::span<const LineQuad> quads) override;
+    virtual void setStaticLines(std::span<const LineInstance> lines) override;
+    virtual void setStaticLinesShown(size_t first, size_t count, bool shown) override;
+    virtual void drawStaticLines(const Camera& camera) override;
+    virtual void drawGrid(const Grid& grid, const Camera& camera) override;
+    virtual void captureBackdrop(float brightness) override;
+    virtual void drawBackdrop() override;
+    virtual int getWindoWidth() const override;
+    virtual int getWindowHeight() const override;
+    virtual int getTicks() const override;
+    virtual void imageDisplay(const std::string& fileName, int x, int y) override;
+    virtual size_t imageLoad(const std::string& fileName) override;
+    virtual void imageDisplay(size_t id, int x, int y) override;
+    virtual void imageUnload(size_t id) override;
+    virtual void drawStatusBar() override;
+    virtual void drawText(const Text& text) override;
+    virtual void drawMenu(std::vector<MenuItem> menuItems, int currentlyHighlightedItem) override;
+    virtual void registerControlHandler(
+        KeyControls key,
+        std::function<void(const bool, const float)> controlHandler) override;
+    virtual void processInput(bool paused) override;
+    virtual KeyControls processMenuInput() override;
+    virtual void soundLoad(const std::string& key, const std::string& filename) override;
+    virtual void soundPlay(const std::string& key) override;
+    virtual void soundLoop(const std::string& key, float volume) override;
+    virtual void soundFade(const std::string& key, const int msecs) override;
+    virtual void musicLoad(const std::string& filename) override;
+    virtual void musicPlayLoop() override;
+    virtual void
+    rumble(uint16_t lowFreqIntensity, uint16_t highFreqIntensity, uint32_t durationMs) override;
+    virtual float getScalingFactor() override;
+
+private:
+    // Formatting is skipped entirely unless recording
+    template <typename... Args>
+    void record(std::format_string<Args...> format, Args&&... args)
+    {
+        if (m_recording) {
+            m_recordingEntries.push_back(
+                std::format("{} ", m_counters.frames)
+                + std::format(format, std::forward<Args>(args)...));
+        }
+    }
+    // Returns the next scripted event due this frame, if there is one
+    const InputEvent* nextEvent();
+    void deliver(const InputEvent& event);
+
+    int m_screenWidth;
+    int m_screenHeight;
+    unsigned m_frameRate { 100 };
+    NullGraphicsCounters m_counters;
+    bool m_recording { false };
+    std::vector<std::string> m_recordingEntries;
+    std::vector<InputEvent> m_script;
+    size_t m_nextEvent { 0 };
+    // Presses which came while paused, see processInput()
+    std::vector<InputEvent> m_heldEvents;
+    std::vector<bool> m_staticLinesShown;
+    size_t m_staticLineCount { 0 }; // shown
+    std::unordered_map<KeyControls, std::function<void(const bool, const float)>> m_controlHandlers;
+};
+
+} // namespace amaze
+} // namespace marengo
@@ -0,0 +1,158 @@
+#include "occupancygrid.h"
+#include "staticgeometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace marengo {
+namespace amaze {
+
+namespace {
+
+// Shape::linesIntersect() truncates coordinates to integers, so a line can
+// collide with things up to a unit away from where it's drawn
+constexpr double margin = 1.0;
+
+// Returns a mask of bits [first, last] of a 64-bit word
+uint64_t bitRange(int first, int last)
+{
+    uint64_t upper = (last == 63) ? ~0ULL : ((1ULL << (last + 1)) - 1);
+    return upper & ~((1ULL << first) - 1);
+}
+
+} // namespace
+
+void OccupancyGrid::clear()
+{
+    m_bits.clear();
+    m_columns = 0;
+    m_rows = 0;
+    m_wordsPerRow = 0;
+}
+
+void OccupancyGrid::build(const std::vector<std::shared_ptr<GameShape>>& shapes)
+{
+    clear();
+
+    // Size the grid to cover all the static geometry (plus padding), which is
+    // usually the 2000x2000 arena
+    BoundingBox extent;
+    double padding = margin;
+    for (const auto& shape : shapes) {
+        if (!StaticGeometry::isIndexed(shape->getGameShapeType()) || shape->getVec().empty()) {
+            continue;
+        }
+        BoundingBox bounds = shape->getBounds();
+        extent.minX = std::min(extent.minX, bounds.minX);
+        extent.minY = std::min(extent.minY, bounds.minY);
+        extent.maxX = std::max(extent.maxX, bounds.maxX);
+        extent.maxY = std::max(extent.maxY, bounds.maxY);
+        for (const auto& sl : shape->getVec()) {
+            padding = std::max(padding, margin + std::max(sl.lineThickness, 1) / 2.0);
+        }
+    }
+    if (extent.minX > extent.maxX) {
+        return; // nothing static in this Level
+    }
+    m_originX = std::floor(extent.minX - padding);
+    m_originY = std::floor(extent.minY - padding);
+    m_columns = static_cast<int>((extent.maxX + padding - m_originX) / m_cellSize) + 1;
+    m_rows = static_cast<int>((extent.maxY + padding - m_originY) / m_cellSize) + 1;
+    m_wordsPerRow = (m_columns + 63) / 64;
+    m_bits.assign(static_cast<size_t>(m_wordsPerRow) * m_rows, 0);
+
+    for (const auto& shape : shapes) {
+        if (!StaticGeometry::isIndexed(shape->getGameShapeType())) {
+            continue;
+        }
+        for (const auto& sl : shape->getVec()) {
+            markSegment(sl, shape->getPosX(), shape->getPosY());
+        }
+    }
+}
+
+void OccupancyGrid::markSegment(const ShapeLine& line, double posX, double posY)
+{
+    // Marks every cell touched by the segment grown by "radius" in each
+    // direction (i.e. swept by a square), one row of cells at a time
+    double radius = margin + std::max(line.lineThickness, 1) / 2.0;
+    double x0 = line.x0 + posX;
+    double y0 = line.y0 + posY;
+    double x1 = line.x1 + posX;
+    double y1 = line.y1 + posY;
+    int firstRow = row(std::min(y0, y1) - radius);
+    int lastRow = row(std::max(y0, y1) + radius);
+    for (int r = firstRow; r <= lastRow; ++r) {
+        // The band of y values which would touch this row
+        double bandMin = m_originY + r * m_cellSize - radius;
+        double bandMax = bandMin + m_cellSize + 2.0 * radius;
+        double tMin = 0.0;
+        double tMax = 1.0;
+        if (y1 != y0) {
+            tMin = (bandMin - y0) / (y1 - y0);
+            tMax = (bandMax - y0) / (y1 - y0);
+            if (tMin > tMax) {
+                std::swap(tMin, tMax);
+            }
+            tMin = std::max(tMin, 0.0);
+            tMax = std::min(tMax, 1.0);
+            if (tMin > tMax) {
+                continue;
+            }
+        }
+        double xa = x0 + tMin * (x1 - x0);
+        double xb = x0 + tMax * (x1 - x0);
+        markRow(r, std::min(xa, xb) - radius, std::max(xa, xb) + radius);
+    }
+}
+
+void OccupancyGrid::markRow(int r, double minX, double maxX)
+{
+    int first = column(minX);
+    int last = column(maxX);
+    uint64_t* words = m_bits.data() + static_cast<size_t>(r) * m_wordsPerRow;
+    for (int c = first; c <= last; ++c) {
+        words[c / 64] |= 1ULL << (c % 64);
+    }
+}
+
+bool OccupancyGrid::isEmpty(const BoundingBox& box) const
+{
+    if (m_bits.empty() || box.minX > box.maxX) {
+        return true;
+    }
+    int firstColumn = column(box.minX - margin);
+    int lastColumn = column(box.maxX + margin);
+    int firstRow = row(box.minY - margin);
+    int lastRow = row(box.maxY + margin);
+    int firstWord = firstColumn / 64;
+    int lastWord = lastColumn / 64;
+    for (int r = firstRow; r <= lastRow; ++r) {
+        const uint64_t* words = m_bits.data() + static_cast<size_t>(r) * m_wordsPerRow;
+        for (int w = firstWord; w <= lastWord; ++w) {
+            int firstBit = (w == firstWord) ? firstColumn % 64 : 0;
+            int lastBit = (w == lastWord) ? lastColumn % 64 : 63;
+            if (words[w] & bitRange(firstBit, lastBit)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int OccupancyGrid::column(double x) const
+{
+    // Anything beyond the edges is clamped to them: there's no geometry
+    // outside the grid so this can only ever over-report
+    double c = std::floor((x - m_originX) / m_cellSize);
+    return static_cast<int>(std::clamp(c, 0.0, m_columns - 1.0));
+}
+
+int OccupancyGrid::row(double y) const
+{
+    double r = std::floor((y - m_originY) / m_cellSize);
+    return static_cast<int>(std::clamp(r, 0.0, m_rows - 1.0));
+}
+
+} // namespace amaze
+} // namespace marengo
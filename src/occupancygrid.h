@@ -0,0 +1,50 @@
+#pragma once
+
+#include "gameshape.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A coarse bitmap of which parts of the Level contain static geometry (the
+// same shapes as StaticGeometry indexes), one bit per cell. It is built once
+// per Level load and answers "is there anything at all in this box?" far more
+// cheaply than a query of the full index, which most frames (flying along an
+// open corridor) don't need.
+//
+// Segments are rasterised conservatively: a cell is marked if it comes
+// anywhere near a line, allowing for the line's thickness and the integer
+// truncation in Shape::linesIntersect(). So if isEmpty() returns true there
+// definitely is no collision in that box; if it returns false there might be.
+// Shapes which are deactivated later stay marked, which is also conservative.
+
+namespace marengo {
+namespace amaze {
+
+class OccupancyGrid {
+public:
+    void clear();
+    void build(const std::vector<std::shared_ptr<GameShape>>& shapes);
+
+    // Returns true if no static geometry lies within the box
+    bool isEmpty(const BoundingBox& box) const;
+
+private:
+    void markSegment(const ShapeLine& line, double posX, double posY);
+    void markRow(int r, double minX, double maxX);
+    int column(double x) const;
+    int row(double y) const;
+
+    static constexpr double m_cellSize { 4.0 };
+
+    // World coordinates of the top left of cell (0, 0)
+    double m_originX { 0.0 };
+    double m_originY { 0.0 };
+    int m_columns { 0 };
+    int m_rows { 0 };
+    int m_wordsPerRow { 0 };
+    std::vector<uint64_t> m_bits;
+};
+
+} // namespace amaze
+} // namespace marengo
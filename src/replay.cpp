@@ -0,0 +1,105 @@
+#include "replay.h"
+#include "exceptions.h"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace marengo {
+namespace amaze {
+
+namespace {
+
+// A levelFile path longer than this means the file is corrupt
+constexpr uint32_t maxLevelFileLength = 4096;
+
+constexpr char replayMagic[8] = { 'A', 'M', 'Z', 'R', 'P', '0', '0', '2' };
+
+template <typename T> void writeValue(std::ofstream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T> T readValue(std::ifstream& in)
+{
+    T value {};
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+} // namespace
+
+void saveReplay(const std::string& fileName, const Replay& replay)
+{
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    out.write(replayMagic, sizeof(replayMagic));
+    writeValue(out, replay.seed);
+    writeValue(out, replay.gameLevel);
+    writeValue(out, replay.tickRate);
+    writeValue(out, replay.steps);
+    writeValue(out, static_cast<uint8_t>(replay.continuousCollision));
+    writeValue(out, static_cast<uint32_t>(replay.levelFile.size()));
+    out.write(replay.levelFile.data(), static_cast<std::streamsize>(replay.levelFile.size()));
+    writeValue(out, static_cast<uint32_t>(replay.events.size()));
+    // Ten bytes per event
+    for (const auto& event : replay.events) {
+        writeValue(out, event.step);
+        writeValue(out, static_cast<uint8_t>(event.key));
+        writeValue(out, static_cast<uint8_t>(event.isKeyDown));
+        writeValue(out, event.value);
+    }
+    if (!out) {
+        THROWUP(AmazeRuntimeException, std::format("Could not write replay to {}", fileName));
+    }
+}
+
+Replay loadReplay(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in) {
+        THROWUP(AmazeRuntimeException, std::format("Could not open replay {}", fileName));
+    }
+    char magic[sizeof(replayMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, replayMagic, sizeof(magic)) != 0) {
+        THROWUP(AmazeRuntimeException, std::format("{} is not a replay", fileName));
+    }
+    Replay replay;
+    replay.seed = readValue<uint32_t>(in);
+    replay.gameLevel = readValue<int32_t>(in);
+    replay.tickRate = readValue<uint32_t>(in);
+    replay.steps = readValue<uint32_t>(in);
+    replay.continuousCollision = readValue<uint8_t>(in) != 0;
+    uint32_t levelFileLength = readValue<uint32_t>(in);
+    if (!in || levelFileLength > maxLevelFileLength) {
+        THROWUP(AmazeRuntimeException, std::format("Bad Level file name in replay {}", fileName));
+    }
+    replay.levelFile.resize(levelFileLength);
+    in.read(replay.levelFile.data(), static_cast<std::streamsize>(replay.levelFile.size()));
+    uint32_t eventCount = readValue<uint32_t>(in);
+    for (uint32_t n = 0; n < eventCount && in; ++n) {
+        ReplayEvent event;
+        event.step = readValue<uint32_t>(in);
+        uint8_t key = readValue<uint8_t>(in);
+        if (key >= static_cast<uint8_t>(KeyControls::NONE)) {
+            THROWUP(AmazeRuntimeException, std::format("Bad input event in replay {}", fileName));
+        }
+        event.key = static_cast<KeyControls>(key);
+        event.isKeyDown = readValue<uint8_t>(in) != 0;
+        event.value = readValue<float>(in);
+        // Playback relies on this, to stop at the first event that is not due
+        if (!replay.events.empty() && event.step < replay.events.back().step) {
+            THROWUP(
+                AmazeRuntimeException,
+                std::format("Events out of order in replay {}", fileName));
+        }
+        replay.events.push_back(event);
+    }
+    if (!in) {
+        THROWUP(AmazeRuntimeException, std::format("Replay {} is truncated", fileName));
+    }
+    return replay;
+}
+
+} // namespace amaze
+} // namespace marengo
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "igraphicsadapter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A recording of a game's input, from which it can be played again exactly:
+// the simulation is deterministic given its random seed, Level, tick rate and
+// collision settings, so replaying the same control events at the same
+// simulation steps gives the same game.
+
+namespace marengo {
+namespace amaze {
+
+struct ReplayEvent {
+    uint32_t step; // the simulation step in which it was handled
+    KeyControls key;
+    bool isKeyDown;
+    float value;
+};
+
+struct Replay {
+    uint32_t seed { 0 };
+    int32_t gameLevel { 0 };
+    std::string levelFile; // if set, used instead of gameLevel
+    uint32_t tickRate { 100 };
+    bool continuousCollision { false }; // it changes what the ship collides with
+    uint32_t steps { 0 }; // length of the recording
+    std::vector<ReplayEvent> events; // in step order
+};
+
+void saveReplay(const std::string& fileName, const Replay& replay);
+Replay loadReplay(const std::string& fileName);
+
+} // namespace amaze
+} // namespace marengo
@@ -34,6 +34,11 @@ void Scheduler::addScheduleItem(ScheduleItem&& si)
     m_scheduleItems.push_back(std::move(si));
 }
 
+void Scheduler::cancel(ScheduleEventName name)
+{
+    std::erase_if(m_scheduleItems, [&](const ScheduleItem& si) { return si.name == name; });
+}
+
 bool Scheduler::isScheduleItemActive(ScheduleEventName name)
 {
     for (auto& si : m_scheduleItems) {
@@ -44,6 +49,16 @@ bool Scheduler::isScheduleItemActive(ScheduleEventName name)
     return false;
 }
 
+int Scheduler::framesRemaining(ScheduleEventName name) const
+{
+    for (const auto& si : m_scheduleItems) {
+        if (si.name == name) {
+            return si.numberOfFrames;
+        }
+    }
+    return 0;
+}
+
 void Scheduler::processSchedule()
 {
     for (auto& si : m_scheduleItems) {
@@ -10,7 +10,8 @@ namespace amaze {
 enum class ScheduleEventName {
     LevelEnded,
     Exploding,
-    BreakableExploding
+    BreakableExploding,
+    Respawning
 };
 
 struct ScheduleItem {
@@ -25,7 +26,11 @@ public:
     void doWhile(ScheduleEventName name, int frames, std::function<void()> fn);
     void doAfter(ScheduleEventName name, int frames, std::function<void()> fn);
     void addScheduleItem(ScheduleItem&& si);
+    // Removes the named item without calling its doAfter
+    void cancel(ScheduleEventName name);
     bool isScheduleItemActive(ScheduleEventName name);
+    // Frames left until the named item ends, or zero if it isn't active
+    int framesRemaining(ScheduleEventName name) const;
     void processSchedule();
 
 private:
@@ -0,0 +1,262 @@
+#include "segmentkernel.h"
+#include "shape.h"
+
+#ifdef AMAZE_SEGMENTKERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace marengo {
+namespace amaze {
+namespace segmentkernel {
+
+size_t intersectScalar(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices)
+{
+    size_t hits = 0;
+    for (size_t n = 0; n < count; ++n) {
+        if (Shape::linesIntersect(
+                probe.x0, probe.y0, probe.x1, probe.y1, x0[n], y0[n], x1[n], y1[n])) {
+            hitIndices[hits++] = static_cast<uint32_t>(n);
+        }
+    }
+    return hits;
+}
+
+#ifdef AMAZE_SEGMENTKERNEL_X86
+
+// The vector kernels below mirror Shape::linesIntersect() operation for
+// operation, but evaluate every test for all lanes and combine them as
+// masks rather than branching. The (short) casts there are reproduced by
+// truncating towards zero, which gives the same result for any coordinate
+// which fits in a short.
+//
+// Note these must not be compiled with FMA enabled, as contracting the
+// multiply/subtract pairs would change the rounding of the alpha and beta
+// numerators and so could change the result.
+
+namespace {
+
+// Scalar test of segments [first, count), for the tail of a batch
+size_t intersectRemainder(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t first,
+    size_t count,
+    uint32_t* hitIndices)
+{
+    size_t hits = intersectScalar(
+        probe, x0 + first, y0 + first, x1 + first, y1 + first, count - first, hitIndices);
+    for (size_t h = 0; h < hits; ++h) {
+        hitIndices[h] += static_cast<uint32_t>(first);
+    }
+    return hits;
+}
+
+// SSE2 has no rounding instruction, so truncate via a round trip through int32
+__m128d truncSse2(__m128d v)
+{
+    return _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+}
+
+__attribute__((target("avx2"))) __m256d truncAvx2(__m256d v)
+{
+    return _mm256_round_pd(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+} // namespace
+
+size_t intersectSse2(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices)
+{
+    const double ax = probe.x1 - probe.x0;
+    const double ay = probe.y1 - probe.y0;
+    const __m128d vx0 = _mm_set1_pd(probe.x0);
+    const __m128d vy0 = _mm_set1_pd(probe.y0);
+    const __m128d vax = _mm_set1_pd(ax);
+    const __m128d vay = _mm_set1_pd(ay);
+    const __m128d x1lo = _mm_set1_pd(static_cast<short>(ax < 0 ? probe.x1 : probe.x0));
+    const __m128d x1hi = _mm_set1_pd(static_cast<short>(ax < 0 ? probe.x0 : probe.x1));
+    const __m128d y1lo = _mm_set1_pd(static_cast<short>(ay < 0.0 ? probe.y1 : probe.y0));
+    const __m128d y1hi = _mm_set1_pd(static_cast<short>(ay < 0.0 ? probe.y0 : probe.y1));
+    const __m128d zero = _mm_setzero_pd();
+
+    size_t hits = 0;
+    size_t n = 0;
+    for (; n + 2 <= count; n += 2) {
+        __m128d x2 = _mm_loadu_pd(x0 + n);
+        __m128d y2 = _mm_loadu_pd(y0 + n);
+        __m128d x3 = _mm_loadu_pd(x1 + n);
+        __m128d y3 = _mm_loadu_pd(y1 + n);
+
+        // X bound box test
+        __m128d bx = _mm_sub_pd(x2, x3);
+        __m128d bxPos = _mm_cmpgt_pd(bx, zero);
+        __m128d tx2 = truncSse2(x2);
+        __m128d tx3 = truncSse2(x3);
+        __m128d lo = _mm_or_pd(_mm_and_pd(bxPos, tx3), _mm_andnot_pd(bxPos, tx2));
+        __m128d hi = _mm_or_pd(_mm_and_pd(bxPos, tx2), _mm_andnot_pd(bxPos, tx3));
+        __m128d reject = _mm_or_pd(_mm_cmplt_pd(x1hi, lo), _mm_cmplt_pd(hi, x1lo));
+
+        // Y bound box test
+        __m128d by = _mm_sub_pd(y2, y3);
+        __m128d byPos = _mm_cmpgt_pd(by, zero);
+        __m128d ty2 = truncSse2(y2);
+        __m128d ty3 = truncSse2(y3);
+        lo = _mm_or_pd(_mm_and_pd(byPos, ty3), _mm_andnot_pd(byPos, ty2));
+        hi = _mm_or_pd(_mm_and_pd(byPos, ty2), _mm_andnot_pd(byPos, ty3));
+        reject = _mm_or_pd(reject, _mm_or_pd(_mm_cmplt_pd(y1hi, lo), _mm_cmplt_pd(hi, y1lo)));
+        if (_mm_movemask_pd(reject) == 0x3) {
+            continue; // nothing nearby, which is the usual case
+        }
+
+        __m128d cx = _mm_sub_pd(vx0, x2);
+        __m128d cy = _mm_sub_pd(vy0, y2);
+        __m128d d = _mm_sub_pd(_mm_mul_pd(by, cx), _mm_mul_pd(bx, cy)); // alpha numerator
+        __m128d f = _mm_sub_pd(_mm_mul_pd(vay, bx), _mm_mul_pd(vax, by)); // both denominator
+        __m128d e = _mm_sub_pd(_mm_mul_pd(vax, cy), _mm_mul_pd(vay, cx)); // beta numerator
+        __m128d fPos = _mm_cmpgt_pd(f, zero);
+
+        // alpha and beta tests
+        __m128d rejectPos = _mm_or_pd(
+            _mm_or_pd(_mm_cmplt_pd(d, zero), _mm_cmpgt_pd(d, f)),
+            _mm_or_pd(_mm_cmplt_pd(e, zero), _mm_cmpgt_pd(e, f)));
+        __m128d rejectNeg = _mm_or_pd(
+            _mm_or_pd(_mm_cmpgt_pd(d, zero), _mm_cmplt_pd(d, f)),
+            _mm_or_pd(_mm_cmpgt_pd(e, zero), _mm_cmplt_pd(e, f)));
+        reject = _mm_or_pd(
+            reject, _mm_or_pd(_mm_and_pd(fPos, rejectPos), _mm_andnot_pd(fPos, rejectNeg)));
+
+        int mask = ~_mm_movemask_pd(reject) & 0x3;
+        while (mask != 0) {
+            int lane = __builtin_ctz(mask);
+            hitIndices[hits++] = static_cast<uint32_t>(n + lane);
+            mask &= mask - 1;
+        }
+    }
+    return hits + intersectRemainder(probe, x0, y0, x1, y1, n, count, hitIndices + hits);
+}
+
+__attribute__((target("avx2"))) size_t intersectAvx2(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices)
+{
+    const double ax = probe.x1 - probe.x0;
+    const double ay = probe.y1 - probe.y0;
+    const __m256d vx0 = _mm256_set1_pd(probe.x0);
+    const __m256d vy0 = _mm256_set1_pd(probe.y0);
+    const __m256d vax = _mm256_set1_pd(ax);
+    const __m256d vay = _mm256_set1_pd(ay);
+    const __m256d x1lo = _mm256_set1_pd(static_cast<short>(ax < 0 ? probe.x1 : probe.x0));
+    const __m256d x1hi = _mm256_set1_pd(static_cast<short>(ax < 0 ? probe.x0 : probe.x1));
+    const __m256d y1lo = _mm256_set1_pd(static_cast<short>(ay < 0.0 ? probe.y1 : probe.y0));
+    const __m256d y1hi = _mm256_set1_pd(static_cast<short>(ay < 0.0 ? probe.y0 : probe.y1));
+    const __m256d zero = _mm256_setzero_pd();
+
+    size_t hits = 0;
+    size_t n = 0;
+    for (; n + 4 <= count; n += 4) {
+        __m256d x2 = _mm256_loadu_pd(x0 + n);
+        __m256d y2 = _mm256_loadu_pd(y0 + n);
+        __m256d x3 = _mm256_loadu_pd(x1 + n);
+        __m256d y3 = _mm256_loadu_pd(y1 + n);
+
+        // X bound box test
+        __m256d bx = _mm256_sub_pd(x2, x3);
+        __m256d bxPos = _mm256_cmp_pd(bx, zero, _CMP_GT_OQ);
+        __m256d tx2 = truncAvx2(x2);
+        __m256d tx3 = truncAvx2(x3);
+        __m256d lo = _mm256_blendv_pd(tx2, tx3, bxPos);
+        __m256d hi = _mm256_blendv_pd(tx3, tx2, bxPos);
+        __m256d reject = _mm256_or_pd(
+            _mm256_cmp_pd(x1hi, lo, _CMP_LT_OQ), _mm256_cmp_pd(hi, x1lo, _CMP_LT_OQ));
+
+        // Y bound box test
+        __m256d by = _mm256_sub_pd(y2, y3);
+        __m256d byPos = _mm256_cmp_pd(by, zero, _CMP_GT_OQ);
+        __m256d ty2 = truncAvx2(y2);
+        __m256d ty3 = truncAvx2(y3);
+        lo = _mm256_blendv_pd(ty2, ty3, byPos);
+        hi = _mm256_blendv_pd(ty3, ty2, byPos);
+        reject = _mm256_or_pd(
+            reject,
+            _mm256_or_pd(
+                _mm256_cmp_pd(y1hi, lo, _CMP_LT_OQ), _mm256_cmp_pd(hi, y1lo, _CMP_LT_OQ)));
+        if (_mm256_movemask_pd(reject) == 0xF) {
+            continue; // nothing nearby, which is the usual case
+        }
+
+        __m256d cx = _mm256_sub_pd(vx0, x2);
+        __m256d cy = _mm256_sub_pd(vy0, y2);
+        __m256d d = _mm256_sub_pd(_mm256_mul_pd(by, cx), _mm256_mul_pd(bx, cy)); // alpha numerator
+        __m256d f = _mm256_sub_pd(_mm256_mul_pd(vay, bx), _mm256_mul_pd(vax, by)); // denominator
+        __m256d e = _mm256_sub_pd(_mm256_mul_pd(vax, cy), _mm256_mul_pd(vay, cx)); // beta numerator
+        __m256d fPos = _mm256_cmp_pd(f, zero, _CMP_GT_OQ);
+
+        // alpha and beta tests
+        __m256d rejectPos = _mm256_or_pd(
+            _mm256_or_pd(_mm256_cmp_pd(d, zero, _CMP_LT_OQ), _mm256_cmp_pd(d, f, _CMP_GT_OQ)),
+            _mm256_or_pd(_mm256_cmp_pd(e, zero, _CMP_LT_OQ), _mm256_cmp_pd(e, f, _CMP_GT_OQ)));
+        __m256d rejectNeg = _mm256_or_pd(
+            _mm256_or_pd(_mm256_cmp_pd(d, zero, _CMP_GT_OQ), _mm256_cmp_pd(d, f, _CMP_LT_OQ)),
+            _mm256_or_pd(_mm256_cmp_pd(e, zero, _CMP_GT_OQ), _mm256_cmp_pd(e, f, _CMP_LT_OQ)));
+        reject = _mm256_or_pd(reject, _mm256_blendv_pd(rejectNeg, rejectPos, fPos));
+
+        int mask = ~_mm256_movemask_pd(reject) & 0xF;
+        while (mask != 0) {
+            int lane = __builtin_ctz(mask);
+            hitIndices[hits++] = static_cast<uint32_t>(n + lane);
+            mask &= mask - 1;
+        }
+    }
+    return hits + intersectRemainder(probe, x0, y0, x1, y1, n, count, hitIndices + hits);
+}
+
+#endif
+
+namespace {
+
+KernelFn selectKernel()
+{
+#ifdef AMAZE_SEGMENTKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return intersectAvx2;
+    }
+    // SSE2 is always present on x86-64
+    return intersectSse2;
+#else
+    return intersectScalar;
+#endif
+}
+
+} // namespace
+
+KernelFn bestKernel()
+{
+    static const KernelFn fn = selectKernel();
+    return fn;
+}
+
+} // namespace segmentkernel
+} // namespace amaze
+} // namespace marengo
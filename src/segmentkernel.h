@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Batched line segment intersection tests. One "probe" segment is tested
+// against many "wall" segments held as structure-of-arrays, several at a time
+// using SIMD where the CPU supports it.
+//
+// Every kernel gives exactly the same answer as Shape::linesIntersect() for
+// each pair (including its truncation of coordinates to integers), it's just
+// faster. Coordinates are kept as doubles for that reason.
+
+namespace marengo {
+namespace amaze {
+namespace segmentkernel {
+
+struct Segment {
+    double x0;
+    double y0;
+    double x1;
+    double y1;
+};
+
+// Tests probe against walls [0, count). The index of each wall segment
+// which intersects is written to hitIndices (which must have room for
+// count entries); returns the number of hits.
+using KernelFn = size_t (*)(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices);
+
+size_t intersectScalar(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices);
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define AMAZE_SEGMENTKERNEL_X86
+size_t intersectSse2(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices);
+size_t intersectAvx2(
+    const Segment& probe,
+    const double* x0,
+    const double* y0,
+    const double* x1,
+    const double* y1,
+    size_t count,
+    uint32_t* hitIndices);
+#endif
+
+// Returns the fastest kernel supported by this CPU (checked once, at first call)
+KernelFn bestKernel();
+
+} // namespace segmentkernel
+} // namespace amaze
+} // namespace marengo
@@ -1,30 +1,61 @@
 #include "sfmladapter.h"
+#include "cameratransform.h"
 #include "exceptions.h"
 #include "gamepad.h"
 #include "log.h"  // IWYU pragma: keep
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <optional>
+#include <utility>
+#include <variant>
 
 namespace marengo {
 namespace amaze {
 
 namespace {
 
-KeyControls joystickRateLimiter(KeyControls key)
+// Writes the six vertices (two triangles) of a rectangle covering the line
+void tessellateLine(const LineInstance& line, sf::Vertex* out)
 {
-    static bool firstCall = true;
-    static auto lastGoodCall = std::chrono::system_clock::now();
-    auto now = std::chrono::system_clock::now();
-    KeyControls rc = KeyControls::NONE;
-    if (firstCall || (now - lastGoodCall) > std::chrono::milliseconds(200)) {
-        lastGoodCall = now;
-        rc = key;
+    sf::Vector2f point1 { line.x0, line.y0 };
+    sf::Vector2f point2 { line.x1, line.y1 };
+    sf::Vector2f direction = point2 - point1;
+    sf::Vector2f unitDirection = direction;
+    float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+    if (length != 0.f) {
+        unitDirection = direction / length;
+    }
+    sf::Vector2f unitPerpendicular(-unitDirection.y, unitDirection.x);
+    sf::Vector2f offset = (line.width / 2.f) * unitPerpendicular;
+    sf::Vector2f corners[6] = { point1 + offset, point2 + offset, point2 - offset,
+                                point1 + offset, point2 - offset, point1 - offset };
+    for (const auto& corner : corners) {
+        out->position = corner;
+        out->color = sf::Color(line.r, line.g, line.b);
+        ++out;
+    }
+}
+
+// As tessellateLine(), but a hidden line's vertices are all at one point, so
+// its triangles cover nothing
+void tessellateStaticLine(const LineInstance& line, bool shown, sf::Vertex* out)
+{
+    if (shown) {
+        tessellateLine(line, out);
+        return;
+    }
+    for (size_t n = 0; n < 6; ++n) {
+        out[n].position = { line.x0, line.y0 };
+        out[n].color = sf::Color::Transparent;
     }
-    firstCall = false;
-    return rc;
+}
+
+bool isShown(const std::shared_ptr<const std::vector<bool>>& shown, size_t n)
+{
+    return !shown || (*shown)[n];
 }
 
 } // anonymous namespace
@@ -51,13 +82,28 @@ SfmlAdapter::SfmlAdapter(
     if (!m_font.openFromFile(dataDir + "/Oxanium-SemiBold.ttf")) {
         THROWUP(AmazeRuntimeException, "Font file load error");
     }
+    // The window's OpenGL context can only be active on one thread at a time
+    if (!m_window.setActive(false)) {
+        THROWUP(AmazeRuntimeException, "Could not release the window for rendering");
+    }
+    m_renderThread = std::thread(&SfmlAdapter::renderLoop, this);
 }
 
-SfmlAdapter::~SfmlAdapter() { }
+SfmlAdapter::~SfmlAdapter()
+{
+    m_stopRendering = true;
+    m_frames.publish(); // wakes the render thread
+    m_renderThread.join();
+}
 
 void SfmlAdapter::setFrameRate(unsigned int fr)
 {
-    m_window.setFramerateLimit(fr);
+    m_frameDuration = std::chrono::steady_clock::duration::zero();
+    if (fr > 0) {
+        m_frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / fr));
+    }
+    m_nextFrame = std::chrono::steady_clock::now();
 }
 
 int SfmlAdapter::getWindowHeight() const
@@ -77,12 +123,93 @@ int SfmlAdapter::getWindoWidth() const
 
 void SfmlAdapter::cls()
 {
-    m_window.clear();
+    m_frames.back().clear();
 }
 
 void SfmlAdapter::redraw()
 {
-    m_window.display();
+    if (m_renderFailed) {
+        std::rethrow_exception(m_renderException);
+    }
+    m_frames.back().staticLines = m_staticLines;
+    m_frames.back().staticLinesShown = publishedStaticLinesShown();
+    m_frames.back().windowWidth = m_screenWidth;
+    m_frames.back().windowHeight = m_screenHeight;
+    m_frames.publish();
+
+    // Keep the game loop to the frame rate. If we've fallen behind we don't
+    // try to catch up.
+    if (m_frameDuration != std::chrono::steady_clock::duration::zero()) {
+        m_nextFrame += m_frameDuration;
+        auto now = std::chrono::steady_clock::now();
+        if (m_nextFrame < now) {
+            m_nextFrame = now;
+        } else {
+            std::this_thread::sleep_until(m_nextFrame);
+        }
+    }
+}
+
+void SfmlAdapter::renderLoop()
+{
+    try {
+        if (!m_window.setActive(true)) {
+            THROWUP(AmazeRuntimeException, "Could not activate the window for rendering");
+        }
+        // Only this thread waits for it; the game loop keeps to the frame
+        // rate by itself (see redraw())
+        m_window.setVerticalSyncEnabled(true);
+        for (;;) {
+            m_frames.waitForNew();
+            if (m_stopRendering) {
+                break;
+            }
+            m_frames.update();
+            setViewSize(m_frames.front());
+            replay(m_frames.front());
+            m_window.display();
+        }
+        (void)m_window.setActive(false);
+    } catch (...) {
+        m_renderException = std::current_exception();
+        m_renderFailed = true;
+    }
+}
+
+void SfmlAdapter::setViewSize(const FramePacket& packet)
+{
+    sf::Vector2u size { packet.windowWidth, packet.windowHeight };
+    if (size == m_viewSize || size.x == 0 || size.y == 0) {
+        return;
+    }
+    // One unit per pixel, as when the window was created
+    m_window.setView(sf::View(sf::FloatRect({ 0.f, 0.f }, sf::Vector2f(size))));
+    m_viewSize = size;
+    // Centred text was laid out for the old size
+    m_textCache.clear();
+    m_textCacheIndex.clear();
+}
+
+void SfmlAdapter::replay(const FramePacket& packet)
+{
+    m_window.clear();
+    for (const auto& command : packet.commands) {
+        if (const auto* lines = std::get_if<FramePacket::Lines>(&command)) {
+            renderLines(std::span(packet.lines).subspan(lines->first, lines->count));
+        } else if (const auto* quads = std::get_if<FramePacket::LineQuads>(&command)) {
+            renderLineQuads(std::span(packet.quads).subspan(quads->first, quads->count));
+        } else if (const auto* staticLines = std::get_if<FramePacket::StaticLines>(&command)) {
+            renderStaticLines(packet, staticLines->camera);
+        } else if (const auto* grid = std::get_if<FramePacket::GridLayer>(&command)) {
+            renderGrid(grid->grid, grid->camera);
+        } else if (const auto* backdrop = std::get_if<FramePacket::Backdrop>(&command)) {
+            renderBackdrop(*backdrop);
+        } else if (std::holds_alternative<FramePacket::StatusBar>(command)) {
+            renderStatusBar();
+        } else if (const auto* text = std::get_if<Text>(&command)) {
+            renderText(*text);
+        }
+    }
 }
 
 int SfmlAdapter::setDrawColour(
@@ -98,34 +225,272 @@ int SfmlAdapter::setDrawColour(
 
 void SfmlAdapter::drawLine(int xFrom, int yFrom, int xTo, int yTo, int width, int r, int g, int b)
 {
-    sf::Vector2f point1 { static_cast<float>(xFrom), static_cast<float>(yFrom) };
-    sf::Vector2f point2 { static_cast<float>(xTo), static_cast<float>(yTo) };
-    sf::VertexArray vertices(sf::PrimitiveType::Lines, 4);
+    LineInstance line { static_cast<float>(xFrom),
+                        static_cast<float>(yFrom),
+                        static_cast<float>(xTo),
+                        static_cast<float>(yTo),
+                        static_cast<float>(width),
+                        static_cast<uint8_t>(r),
+                        static_cast<uint8_t>(g),
+                        static_cast<uint8_t>(b) };
+    drawLines({ &line, 1 });
+}
 
-    sf::Vector2f direction = point2 - point1;
-    sf::Vector2f unitDirection = direction;
-    float divisor = std::sqrt(direction.x * direction.x + direction.y * direction.y);
-    if (divisor != 0.f) {
-        unitDirection
-            = direction / std::sqrt(direction.x * direction.x + direction.y * direction.y);
+void SfmlAdapter::drawLines(std::span<const LineInstance> lines)
+{
+    auto& packet = m_frames.back();
+    packet.commands.push_back(FramePacket::Lines { packet.lines.size(), lines.size() });
+    packet.lines.insert(packet.lines.end(), lines.begin(), lines.end());
+}
+
+void SfmlAdapter::renderLines(std::span<const LineInstance> lines)
+{
+    // Each line is drawn as a rectangle (two triangles) of the required
+    // width, all in a single draw call
+    if (lines.empty()) {
+        return;
     }
-    sf::Vector2f unitPerpendicular(-unitDirection.y, unitDirection.x);
+    m_lineVertices.resize(lines.size() * 6);
+    for (size_t n = 0; n < lines.size(); ++n) {
+        tessellateLine(lines[n], &m_lineVertices[n * 6]);
+    }
+    m_window.draw(m_lineVertices);
+}
 
-    sf::Vector2f offset = (width / 2.f) * unitPerpendicular;
+void SfmlAdapter::drawLineQuads(std::span<const LineQuad> quads)
+{
+    auto& packet = m_frames.back();
+    packet.commands.push_back(FramePacket::LineQuads { packet.quads.size(), quads.size() });
+    packet.quads.insert(packet.quads.end(), quads.begin(), quads.end());
+}
 
-    vertices[0].position = point1 + offset;
-    vertices[1].position = point2 + offset;
-    vertices[2].position = point2 - offset;
-    vertices[3].position = point1 - offset;
+void SfmlAdapter::renderLineQuads(std::span<const LineQuad> quads)
+{
+    // Just two triangles per quad, as the corners are already worked out
+    if (quads.empty()) {
+        return;
+    }
+    m_lineVertices.resize(quads.size() * 6);
+    constexpr size_t cornerOrder[6] = { 0, 1, 2, 0, 2, 3 };
+    for (size_t n = 0; n < quads.size(); ++n) {
+        const LineQuad& quad = quads[n];
+        sf::Color colour(quad.r, quad.g, quad.b);
+        for (size_t v = 0; v < 6; ++v) {
+            sf::Vertex& vertex = m_lineVertices[n * 6 + v];
+            vertex.position = { quad.x[cornerOrder[v]], quad.y[cornerOrder[v]] };
+            vertex.color = colour;
+        }
+    }
+    m_window.draw(m_lineVertices);
+}
 
-    sf::VertexArray triangleFan(sf::PrimitiveType::TriangleFan, 4);
+void SfmlAdapter::setStaticLines(std::span<const LineInstance> lines)
+{
+    // They're sent to the GPU by the render thread when it next draws them
+    m_staticLines = std::make_shared<const std::vector<LineInstance>>(lines.begin(), lines.end());
+    m_staticLinesShown.assign(lines.size(), true);
+    m_publishedStaticLinesShown.reset();
+}
 
-    for (int i = 0; i < 4; ++i) {
-        vertices[i].color = sf::Color(r, g, b);
-        triangleFan[i] = vertices[i];
+void SfmlAdapter::setStaticLinesShown(size_t first, size_t count, bool shown)
+{
+    // The render thread works out which lines have changed, and re-sends just
+    // those, when it next draws them
+    if (first >= m_staticLinesShown.size()) {
+        return;
+    }
+    count = std::min(count, m_staticLinesShown.size() - first);
+    std::fill_n(m_staticLinesShown.begin() + first, count, shown);
+    m_publishedStaticLinesShown.reset();
+}
+
+std::shared_ptr<const std::vector<bool>> SfmlAdapter::publishedStaticLinesShown()
+{
+    if (!m_publishedStaticLinesShown) {
+        m_publishedStaticLinesShown = std::make_shared<const std::vector<bool>>(m_staticLinesShown);
     }
+    return m_publishedStaticLinesShown;
+}
 
-    m_window.draw(triangleFan);
+void SfmlAdapter::drawStaticLines(const Camera& camera)
+{
+    m_frames.back().commands.push_back(FramePacket::StaticLines { camera });
+}
+
+void SfmlAdapter::renderStaticLines(const FramePacket& packet, const Camera& camera)
+{
+    // Lines are only tessellated and uploaded in full when there's a new set
+    // of them (i.e. a new Level), otherwise just those hidden or shown since
+    bool upload = packet.staticLines != m_uploadedStaticLines;
+    if (!upload && packet.staticLinesShown != m_uploadedStaticLinesShown) {
+        upload = !updateStaticLines(packet);
+    }
+    if (upload) {
+        m_uploadedStaticLines = packet.staticLines;
+        m_uploadedStaticLinesShown = packet.staticLinesShown;
+        std::span<const LineInstance> lines;
+        if (m_uploadedStaticLines) {
+            lines = *m_uploadedStaticLines;
+        }
+        m_staticVertices.resize(lines.size() * 6);
+        for (size_t n = 0; n < lines.size(); ++n) {
+            tessellateStaticLine(
+                lines[n], isShown(m_uploadedStaticLinesShown, n), &m_staticVertices[n * 6]);
+        }
+        if (sf::VertexBuffer::isAvailable() && !lines.empty()
+            && m_staticBuffer.create(m_staticVertices.getVertexCount())
+            && m_staticBuffer.update(&m_staticVertices[0])) {
+            m_staticVertices.clear(); // no longer needed
+        } else {
+            m_staticBuffer.create(0);
+        }
+    }
+    auto m = cameratransform::fromCamera(camera);
+    sf::Transform transform(m.a, m.b, m.tx, m.c, m.d, m.ty, 0.f, 0.f, 1.f);
+    if (m_staticBuffer.getVertexCount() > 0) {
+        m_window.draw(m_staticBuffer, transform);
+    } else if (m_staticVertices.getVertexCount() > 0) {
+        m_window.draw(m_staticVertices, transform);
+    }
+}
+
+bool SfmlAdapter::updateStaticLines(const FramePacket& packet)
+{
+    std::span<const LineInstance> lines;
+    if (m_uploadedStaticLines) {
+        lines = *m_uploadedStaticLines;
+    }
+    auto wasShown = std::exchange(m_uploadedStaticLinesShown, packet.staticLinesShown);
+    const auto& shown = packet.staticLinesShown;
+    // Each run of changed lines is re-tessellated, and sent in one update
+    size_t n = 0;
+    while (n < lines.size()) {
+        if (isShown(shown, n) == isShown(wasShown, n)) {
+            ++n;
+            continue;
+        }
+        size_t first = n;
+        while (n < lines.size() && isShown(shown, n) != isShown(wasShown, n)) {
+            ++n;
+        }
+        if (m_staticBuffer.getVertexCount() == 0) {
+            for (size_t line = first; line < n; ++line) {
+                tessellateStaticLine(
+                    lines[line], isShown(shown, line), &m_staticVertices[line * 6]);
+            }
+            continue;
+        }
+        m_lineVertices.resize((n - first) * 6);
+        for (size_t line = first; line < n; ++line) {
+            tessellateStaticLine(
+                lines[line], isShown(shown, line), &m_lineVertices[(line - first) * 6]);
+        }
+        if (!m_staticBuffer.update(
+                &m_lineVertices[0],
+                m_lineVertices.getVertexCount(),
+                static_cast<unsigned>(first * 6))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SfmlAdapter::drawGrid(const Grid& grid, const Camera& camera)
+{
+    m_frames.back().commands.push_back(FramePacket::GridLayer { grid, camera });
+}
+
+void SfmlAdapter::renderGrid(const Grid& grid, const Camera& camera)
+{
+    // One grid square is drawn into a texture, with a line along its top and
+    // left edges, at roughly one texel per screen pixel. The texture is only
+    // redrawn when the square or its lines work out at a different number of
+    // texels, i.e. after the window is resized (the adapter then reports the
+    // new size, and the camera's scale follows).
+    unsigned tileSize = std::clamp(
+        static_cast<unsigned>(std::ceil(grid.spacing * camera.scale)), 8u, 1024u);
+    unsigned lineTexels = std::clamp(
+        static_cast<unsigned>(std::lround(grid.lineWidth / grid.spacing * tileSize)),
+        1u,
+        tileSize);
+    if (tileSize != m_gridTileSize || lineTexels != m_gridLineTexels) {
+        sf::Image tile({ tileSize, tileSize }, sf::Color::Transparent);
+        for (unsigned y = 0; y < tileSize; ++y) {
+            for (unsigned x = 0; x < tileSize; ++x) {
+                if (x < lineTexels || y < lineTexels) {
+                    tile.setPixel({ x, y }, sf::Color::White);
+                }
+            }
+        }
+        if (!m_gridTexture.loadFromImage(tile)) {
+            THROWUP(AmazeRuntimeException, "Could not create grid texture");
+        }
+        m_gridTexture.setRepeated(true);
+        m_gridTexture.setSmooth(true);
+        m_gridTileSize = tileSize;
+        m_gridLineTexels = lineTexels;
+    }
+
+    // The quad covers the grid, lines included, and the texture repeats across
+    // it once per grid square. The white texture is tinted by the vertex
+    // colour.
+    float halfWidth = static_cast<float>(grid.lineWidth / 2.0);
+    float minPos = -halfWidth;
+    float maxPos = static_cast<float>(grid.extent) + halfWidth;
+    float maxTex = static_cast<float>((grid.extent + grid.lineWidth) / grid.spacing * tileSize);
+    const sf::Vector2f corners[4] = { { 0.f, 0.f }, { 1.f, 0.f }, { 0.f, 1.f }, { 1.f, 1.f } };
+    for (size_t n = 0; n < 4; ++n) {
+        m_gridQuad[n].position = { minPos + corners[n].x * (maxPos - minPos),
+                                   minPos + corners[n].y * (maxPos - minPos) };
+        m_gridQuad[n].texCoords = { corners[n].x * maxTex, corners[n].y * maxTex };
+        m_gridQuad[n].color = sf::Color(grid.r, grid.g, grid.b);
+    }
+    auto m = cameratransform::fromCamera(camera);
+    sf::RenderStates states(sf::Transform(m.a, m.b, m.tx, m.c, m.d, m.ty, 0.f, 0.f, 1.f));
+    states.texture = &m_gridTexture;
+    m_window.draw(m_gridQuad, states);
+}
+
+void SfmlAdapter::captureBackdrop(float brightness)
+{
+    // The frame so far is kept, and every packet from now on refers to it,
+    // so that the render thread can capture it from whichever it draws first
+    auto source = std::make_shared<FramePacket>(m_frames.back());
+    source->staticLines = m_staticLines;
+    source->staticLinesShown = publishedStaticLinesShown();
+    m_backdropRequest.source = std::move(source);
+    m_backdropRequest.brightness = brightness;
+    ++m_backdropRequest.generation;
+    drawBackdrop();
+}
+
+void SfmlAdapter::drawBackdrop()
+{
+    m_frames.back().commands.push_back(m_backdropRequest);
+}
+
+void SfmlAdapter::renderBackdrop(const FramePacket::Backdrop& backdrop)
+{
+    // A new backdrop's frame is drawn, copied from the window, then drawn
+    // once, dimmed, into the backdrop
+    if (backdrop.source && backdrop.generation != m_backdropGeneration) {
+        replay(*backdrop.source);
+        if (m_backdropSource.getSize() != m_viewSize) {
+            if (!m_backdropSource.resize(m_viewSize) || !m_backdrop.resize(m_viewSize)) {
+                THROWUP(AmazeRuntimeException, "Could not create backdrop texture");
+            }
+        }
+        m_backdropSource.update(m_window);
+        sf::Sprite sprite(m_backdropSource);
+        auto level = static_cast<uint8_t>(std::clamp(backdrop.brightness, 0.f, 1.f) * 255.f);
+        sprite.setColor(sf::Color(level, level, level));
+        m_backdrop.clear();
+        m_backdrop.draw(sprite);
+        m_backdrop.display();
+        m_window.clear();
+        m_backdropGeneration = backdrop.generation;
+    }
+    m_window.draw(sf::Sprite(m_backdrop.getTexture()));
 }
 
 int SfmlAdapter::getPhysicalScreenWidth()
@@ -159,12 +524,28 @@ void SfmlAdapter::imageUnload(size_t /* id */)
 
 void SfmlAdapter::drawStatusBar()
 {
-    sf::RectangleShape sb(sf::Vector2f(m_screenWidth, 75));
+    m_frames.back().commands.push_back(FramePacket::StatusBar {});
+}
+
+void SfmlAdapter::renderStatusBar()
+{
+    sf::RectangleShape sb(sf::Vector2f(m_viewSize.x, 75));
     sb.setFillColor(sf::Color::Black);
     m_window.draw(sb);
 }
 
-void SfmlAdapter::drawText(const Text& text)
+size_t SfmlAdapter::TextKeyHash::operator()(const TextKey& key) const
+{
+    size_t h = std::hash<std::string>()(key.text);
+    auto combine = [&h](size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+    combine(key.characterSize);
+    combine((key.r << 16) | (key.g << 8) | key.b);
+    combine(std::hash<std::optional<float>>()(key.positionX));
+    combine(std::hash<std::optional<float>>()(key.positionY));
+    return h;
+}
+
+sf::Text SfmlAdapter::layoutText(const Text& text) const
 {
     sf::Text t(m_font);
     t.setCharacterSize(text.characterSize);
@@ -189,7 +570,30 @@ void SfmlAdapter::drawText(const Text& text)
         // If we get here we must have values for both x and y
         t.setPosition({ text.positionX.value(), text.positionY.value() });
     }
-    m_window.draw(t);
+    return t;
+}
+
+void SfmlAdapter::drawText(const Text& text)
+{
+    m_frames.back().commands.push_back(text);
+}
+
+void SfmlAdapter::renderText(const Text& text)
+{
+    TextKey key { text.text, text.characterSize, text.r,        text.g,
+                  text.b,    text.positionX,     text.positionY };
+    auto it = m_textCacheIndex.find(key);
+    if (it != m_textCacheIndex.end()) {
+        m_textCache.splice(m_textCache.begin(), m_textCache, it->second);
+    } else {
+        if (m_textCache.size() >= m_textCacheSize) {
+            m_textCacheIndex.erase(m_textCache.back().key);
+            m_textCache.pop_back();
+        }
+        m_textCache.push_front({ key, layoutText(text) });
+        m_textCacheIndex.emplace(std::move(key), m_textCache.begin());
+    }
+    m_window.draw(m_textCache.front().text);
 }
 
 void SfmlAdapter::drawMenu(std::vector<MenuItem> menuItems, int currentlyHighlightedItem)
@@ -285,6 +689,9 @@ void SfmlAdapter::processInput(bool paused)
         if (event->is<sf::Event::Closed>()) {
             m_controlHandlers[KeyControls::QUIT](true, 0.f);
         }
+        if (const auto* resized = event->getIf<sf::Event::Resized>()) {
+            windowResized(resized->size);
+        }
 
         if (event->is<sf::Event::FocusLost>()) {
             // Pause when window loses focus
@@ -372,6 +779,22 @@ void SfmlAdapter::processInput(bool paused)
     return;
 }
 
+void SfmlAdapter::windowResized(sf::Vector2u size)
+{
+    m_screenWidth = size.x;
+    m_screenHeight = size.y;
+}
+
+KeyControls SfmlAdapter::menuKeyRateLimit(KeyControls key)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (m_lastMenuKeyTime && now - *m_lastMenuKeyTime <= std::chrono::milliseconds(200)) {
+        return KeyControls::NONE;
+    }
+    m_lastMenuKeyTime = now;
+    return key;
+}
+
 KeyControls SfmlAdapter::processMenuInput()
 {
     // If this function is called, the menu is displayed, so we react differently
@@ -384,10 +807,10 @@ KeyControls SfmlAdapter::processMenuInput()
             case gamepad::EventType::Analogue:
                 {
                     if (evt.analogue.leftY < -0.2f || evt.analogue.rightY < -0.2f) {
-                        return joystickRateLimiter(KeyControls::DOWN);
+                        return menuKeyRateLimit(KeyControls::DOWN);
                     }
                     if (evt.analogue.leftY > 0.2f || evt.analogue.rightY > 0.2f) {
-                        return joystickRateLimiter(KeyControls::UP);
+                        return menuKeyRateLimit(KeyControls::UP);
                     }
                     break;
                 }
@@ -413,7 +836,9 @@ KeyControls SfmlAdapter::processMenuInput()
 
     for (;;) {
         const std::optional event = m_window.pollEvent();
-        if (event.has_value() && event->is<sf::Event::KeyPressed>()) {
+        if (event.has_value() && event->is<sf::Event::Resized>()) {
+            windowResized(event->getIf<sf::Event::Resized>()->size);
+        } else if (event.has_value() && event->is<sf::Event::KeyPressed>()) {
             switch (event->getIf<sf::Event::KeyPressed>()->scancode) {
                 case sf::Keyboard::Scancode::Escape:
                     return KeyControls::EXIT;
@@ -1,18 +1,33 @@
 #pragma once
 
-// All SFML-specific code should go in this class
+// All SFML-specific code should go in this class.
+//
+// Drawing is done on a separate render thread: the drawing functions just
+// record what to draw into a FramePacket, and redraw() hands the packet over
+// to the render thread, which replays it to the window. So the game loop
+// never waits for the GPU (or for vsync). Input and sounds are still dealt
+// with on the calling thread.
 
+#include "framepacket.h"
 #include "gamepad.h"
 #include "igraphicsadapter.h"
 #include "menu.h"
+#include "triplebuffer.h"
 
 #include "SFML/Audio.hpp" // IWYU pragma: keep
 #include "SFML/Graphics.hpp" // IWYU pragma: keep
 
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <functional>
+#include <list>
 #include <memory>
+#include <optional>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace marengo {
 namespace amaze {
@@ -32,6 +47,14 @@ public:
     virtual int setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) override;
     virtual void
     drawLine(int xFrom, int yFrom, int xTo, int yTo, int width, int r, int g, int b) override;
+    virtual void drawLines(std::span<const LineInstance> lines) override;
+    virtual void drawLineQuads(std::span<const LineQuad> quads) override;
+    virtual void setStaticLines(std::span<const LineInstance> lines) override;
+    virtual void setStaticLinesShown(size_t first, size_t count, bool shown) override;
+    virtual void drawStaticLines(const Camera& camera) override;
+    virtual void drawGrid(const Grid& grid, const Camera& camera) override;
+    virtual void captureBackdrop(float brightness) override;
+    virtual void drawBackdrop() override;
     static int getPhysicalScreenWidth();
     static int getPhysicalScreenHeight();
     virtual int getWindoWidth() const override;
@@ -61,7 +84,63 @@ public:
     virtual float getScalingFactor() override;
 
 private:
-    sf::RenderWindow m_window;
+    // A window whose view is only changed by the render thread. SFML would
+    // otherwise reset it on a resize, from within pollEvent() on the main
+    // thread, while the render thread is drawing with it.
+    class Window : public sf::RenderWindow {
+    public:
+        using sf::RenderWindow::RenderWindow;
+
+    protected:
+        void onResize() override { }
+    };
+
+    // Everything which affects how a Text is laid out and drawn
+    struct TextKey {
+        std::string text;
+        unsigned characterSize;
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        std::optional<float> positionX;
+        std::optional<float> positionY;
+        bool operator==(const TextKey&) const = default;
+    };
+    struct TextKeyHash {
+        size_t operator()(const TextKey& key) const;
+    };
+    struct CachedText {
+        TextKey key;
+        sf::Text text;
+    };
+
+    sf::Text layoutText(const Text& text) const;
+    // Stops a held analogue stick scrolling through the menu too quickly:
+    // returns the key at most once per 200ms, otherwise NONE
+    KeyControls menuKeyRateLimit(KeyControls key);
+    // Called for the window's Resized events. The render thread follows as it
+    // draws the next packet.
+    void windowResized(sf::Vector2u size);
+    // m_staticLinesShown, as passed to the render thread
+    std::shared_ptr<const std::vector<bool>> publishedStaticLinesShown();
+
+    // Render thread
+    void renderLoop();
+    // Makes the window's view match the size the packet was drawn for
+    void setViewSize(const FramePacket& packet);
+    void replay(const FramePacket& packet);
+    void renderLines(std::span<const LineInstance> lines);
+    void renderLineQuads(std::span<const LineQuad> quads);
+    void renderStaticLines(const FramePacket& packet, const Camera& camera);
+    // Re-sends just the static lines which have been hidden or shown since
+    // they were uploaded. Returns false if they need uploading in full.
+    bool updateStaticLines(const FramePacket& packet);
+    void renderGrid(const Grid& grid, const Camera& camera);
+    void renderBackdrop(const FramePacket::Backdrop& backdrop);
+    void renderStatusBar();
+    void renderText(const Text& text);
+
+    Window m_window;
     int m_screenHeight;
     int m_screenWidth;
 
@@ -70,8 +149,53 @@ private:
     sf::Music m_music;
     std::unordered_map<std::string, std::shared_ptr<sf::Sound>> m_sounds;
     sf::Clock m_clock;
-    sf::Font m_font; // we only use one font for all text currently
     gamepad::Gamepad m_gamepad;
+    std::optional<std::chrono::steady_clock::time_point> m_lastMenuKeyTime;
+    // Game loop pacing, as the window's frame rate limit only applies to the
+    // render thread
+    std::chrono::steady_clock::duration m_frameDuration {};
+    std::chrono::steady_clock::time_point m_nextFrame;
+    std::shared_ptr<const std::vector<LineInstance>> m_staticLines;
+    std::vector<bool> m_staticLinesShown;
+    // A copy of m_staticLinesShown, made when a packet next needs it
+    std::shared_ptr<const std::vector<bool>> m_publishedStaticLinesShown;
+    // What the latest captureBackdrop() call asked for
+    FramePacket::Backdrop m_backdropRequest {};
+
+    // Everything below here is only used by the render thread, apart from
+    // the hand-over of packets and the stop / error flags
+    sf::Font m_font; // we only use one font for all text currently
+    sf::Vector2u m_viewSize; // the window's, as far as the render thread knows
+    // Laid out text, most recently used first, so that unchanged text is
+    // just drawn rather than laid out again every frame
+    std::list<CachedText> m_textCache;
+    std::unordered_map<TextKey, std::list<CachedText>::iterator, TextKeyHash> m_textCacheIndex;
+    static constexpr size_t m_textCacheSize { 64 };
+    // Reused by renderLines() so we don't allocate every frame
+    sf::VertexArray m_lineVertices { sf::PrimitiveType::Triangles };
+    // The static lines live on the GPU if possible, otherwise they're kept
+    // here and sent each frame (but still in one draw call)
+    sf::VertexBuffer m_staticBuffer { sf::PrimitiveType::Triangles,
+                                      sf::VertexBuffer::Usage::Static };
+    sf::VertexArray m_staticVertices { sf::PrimitiveType::Triangles };
+    // The static lines currently in m_staticBuffer / m_staticVertices
+    std::shared_ptr<const std::vector<LineInstance>> m_uploadedStaticLines;
+    std::shared_ptr<const std::vector<bool>> m_uploadedStaticLinesShown;
+    // The grid is one quad, textured with a single repeated grid square
+    sf::Texture m_gridTexture;
+    sf::VertexArray m_gridQuad { sf::PrimitiveType::TriangleStrip, 4 };
+    unsigned m_gridTileSize { 0 };
+    unsigned m_gridLineTexels { 0 };
+    // A copy of the window's contents, and that copy dimmed
+    sf::Texture m_backdropSource;
+    sf::RenderTexture m_backdrop;
+    unsigned m_backdropGeneration { 0 }; // of the backdrop in m_backdrop
+    TripleBuffer<FramePacket> m_frames;
+    std::atomic<bool> m_stopRendering { false };
+    // Anything thrown on the render thread is passed back to redraw()
+    std::atomic<bool> m_renderFailed { false };
+    std::exception_ptr m_renderException;
+    std::thread m_renderThread;
 };
 
 } // namespace amaze
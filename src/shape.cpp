@@ -3,6 +3,7 @@
 #include "utils.h"
 #include "vectorfont.h"
 
+#include <algorithm>
 #include <cmath>
 #include <format>
 #include <sstream>
@@ -12,6 +13,27 @@
 namespace marengo {
 namespace amaze {
 
+namespace {
+
+// Shape::linesIntersect() compares coordinates truncated to integers, so
+// two segments up to a unit apart can still be reported as touching. Any
+// bounding box rejection done before calling it must allow for that.
+constexpr double boundsMargin = 1.0;
+
+} // namespace
+
+bool BoundingBox::overlaps(const BoundingBox& other, double margin) const
+{
+    return minX <= other.maxX + margin && other.minX <= maxX + margin
+        && minY <= other.maxY + margin && other.minY <= maxY + margin;
+}
+
+bool BoundingBox::overlapsLine(double x0, double y0, double x1, double y1, double margin) const
+{
+    return minX <= std::max(x0, x1) + margin && std::min(x0, x1) <= maxX + margin
+        && minY <= std::max(y0, y1) + margin && std::min(y0, y1) <= maxY + margin;
+}
+
 Shape::Shape() { }
 
 Shape::~Shape() { }
@@ -64,11 +86,14 @@ void Shape::makeFromText(
         sl.x1 -= (m_width / 2);
         sl.y1 -= (m_height / 2);
     }
+    recalculateBounds();
 }
 
 void Shape::addShapeLine(ShapeLine sl)
 {
+    updatePerpendicular(sl);
     updateShapeSize(sl.x0, sl.y0, sl.x1, sl.y1);
+    expandBounds(sl);
     m_shapeLines.push_back(sl);
 }
 
@@ -139,20 +164,24 @@ void Shape::rotate(double rotationDelta)
     tmp.reserve(m_shapeLines.size());
 
     double rd = std::fmod(rotationDelta, 360.0);
+    double dCos = utils::cosine(rd);
+    double dSin = utils::sine(rd);
 
     for (ShapeLine line : m_shapeLines) {
-        double x0r = line.x0 * utils::cosine(rd) - line.y0 * utils::sine(rd);
-        double y0r = line.x0 * utils::sine(rd) + line.y0 * utils::cosine(rd);
-        double x1r = line.x1 * utils::cosine(rd) - line.y1 * utils::sine(rd);
-        double y1r = line.x1 * utils::sine(rd) + line.y1 * utils::cosine(rd);
+        double x0r = line.x0 * dCos - line.y0 * dSin;
+        double y0r = line.x0 * dSin + line.y0 * dCos;
+        double x1r = line.x1 * dCos - line.y1 * dSin;
+        double y1r = line.x1 * dSin + line.y1 * dCos;
 
         line.x0 = x0r;
         line.y0 = y0r;
         line.x1 = x1r;
         line.y1 = y1r;
+        updatePerpendicular(line);
         tmp.push_back(line);
     }
     std::swap(tmp, m_shapeLines);
+    recalculateBounds();
 }
 
 void Shape::clear()
@@ -165,6 +194,7 @@ void Shape::clear()
     m_maxX = 0;
     m_maxY = 0;
     m_rotation = 0;
+    m_localBounds = BoundingBox();
 }
 
 void Shape::resize(double scale)
@@ -180,100 +210,127 @@ void Shape::resize(double scale)
     }
     m_width = static_cast<int>(static_cast<double>(m_width) * m_scale);
     m_height = static_cast<int>(static_cast<double>(m_height) * m_scale);
+    recalculateBounds();
 }
 
 bool Shape::intersectCheck(std::shared_ptr<Shape> s) const
 {
-    // check for intersect with all of my lines against all of another object's:
-    for (size_t myLine = 0; myLine < m_shapeLines.size(); ++myLine) {
-        double x0 = m_shapeLines[myLine].x0 + m_x;
-        double y0 = m_shapeLines[myLine].y0 + m_y;
-        double x1 = m_shapeLines[myLine].x1 + m_x;
-        double y1 = m_shapeLines[myLine].y1 + m_y;
-        for (unsigned int theirLine = 0; theirLine < s->getVec().size(); ++theirLine) {
-            double x2 = s->getVec()[theirLine].x0 + s->getPosX();
-            double y2 = s->getVec()[theirLine].y0 + s->getPosY();
-            double x3 = s->getVec()[theirLine].x1 + s->getPosX();
-            double y3 = s->getVec()[theirLine].y1 + s->getPosY();
-
-            double ax, bx, cx, ay, by, cy, d, e, f;
-            short x1lo, x1hi, y1lo, y1hi;
-
-            ax = x1 - x0;
-            bx = x2 - x3;
-
-            // X bound box test:
-            if (ax < 0) {
-                x1lo = (short)x1;
-                x1hi = (short)x0;
-            } else {
-                x1hi = (short)x1;
-                x1lo = (short)x0;
-            }
-            if (bx > 0) {
-                if (x1hi < (short)x3 || (short)x2 < x1lo) {
-                    continue;
-                }
-            } else {
-                if (x1hi < (short)x2 || (short)x3 < x1lo) {
-                    continue;
-                }
+    // Most shapes tested are nowhere near each other:
+    BoundingBox myBounds = getBounds();
+    if (!myBounds.overlaps(s->getBounds(), boundsMargin)) {
+        return false;
+    }
+    // check for intersect with all of my lines against all of another object's,
+    // ignoring any of theirs which are outside my bounding box:
+    const auto& theirLines = s->getVec();
+    double theirX = s->getPosX();
+    double theirY = s->getPosY();
+    for (const auto& theirLine : theirLines) {
+        double x2 = theirLine.x0 + theirX;
+        double y2 = theirLine.y0 + theirY;
+        double x3 = theirLine.x1 + theirX;
+        double y3 = theirLine.y1 + theirY;
+        if (!myBounds.overlapsLine(x2, y2, x3, y3, boundsMargin)) {
+            continue;
+        }
+        for (const auto& myLine : m_shapeLines) {
+            double x0 = myLine.x0 + m_x;
+            double y0 = myLine.y0 + m_y;
+            double x1 = myLine.x1 + m_x;
+            double y1 = myLine.y1 + m_y;
+            if (linesIntersect(x0, y0, x1, y1, x2, y2, x3, y3)) {
+                return true;
             }
+        }
+    }
+    // if we get here we had no intersects
+    return false;
+}
 
-            ay = y1 - y0;
-            by = y2 - y3;
+bool Shape::linesIntersect(
+    double x0,
+    double y0,
+    double x1,
+    double y1,
+    double x2,
+    double y2,
+    double x3,
+    double y3)
+{
+    double ax, bx, cx, ay, by, cy, d, e, f;
+    short x1lo, x1hi, y1lo, y1hi;
+
+    ax = x1 - x0;
+    bx = x2 - x3;
+
+    // X bound box test:
+    if (ax < 0) {
+        x1lo = (short)x1;
+        x1hi = (short)x0;
+    } else {
+        x1hi = (short)x1;
+        x1lo = (short)x0;
+    }
+    if (bx > 0) {
+        if (x1hi < (short)x3 || (short)x2 < x1lo) {
+            return false;
+        }
+    } else {
+        if (x1hi < (short)x2 || (short)x3 < x1lo) {
+            return false;
+        }
+    }
 
-            // Y bound box test
-            if (ay < 0.0) {
-                y1lo = (short)y1;
-                y1hi = (short)y0;
-            } else {
-                y1hi = (short)y1;
-                y1lo = (short)y0;
-            }
-            if (by > 0.0) {
-                if (y1hi < (short)y3 || (short)y2 < y1lo) {
-                    continue;
-                }
-            } else {
-                if (y1hi < (short)y2 || (short)y3 < y1lo) {
-                    continue;
-                }
-            }
+    ay = y1 - y0;
+    by = y2 - y3;
 
-            cx = x0 - x2;
-            cy = y0 - y2;
-            d = by * cx - bx * cy; // alpha numerator
-            f = ay * bx - ax * by; // both denominator
-            // alpha tests
-            if (f > 0.0) {
-                if (d < 0.0 || d > f) {
-                    continue;
-                }
-            } else {
-                if (d > 0.0 || d < f) {
-                    continue;
-                }
-            }
+    // Y bound box test
+    if (ay < 0.0) {
+        y1lo = (short)y1;
+        y1hi = (short)y0;
+    } else {
+        y1hi = (short)y1;
+        y1lo = (short)y0;
+    }
+    if (by > 0.0) {
+        if (y1hi < (short)y3 || (short)y2 < y1lo) {
+            return false;
+        }
+    } else {
+        if (y1hi < (short)y2 || (short)y3 < y1lo) {
+            return false;
+        }
+    }
 
-            e = ax * cy - ay * cx; // beta numerator
-            // beta tests
-            if (f > 0.0) {
-                if (e < 0.0 || e > f) {
-                    continue;
-                }
-            } else {
-                if (e > 0.0 || e < f) {
-                    continue;
-                }
-            }
+    cx = x0 - x2;
+    cy = y0 - y2;
+    d = by * cx - bx * cy; // alpha numerator
+    f = ay * bx - ax * by; // both denominator
+    // alpha tests
+    if (f > 0.0) {
+        if (d < 0.0 || d > f) {
+            return false;
+        }
+    } else {
+        if (d > 0.0 || d < f) {
+            return false;
+        }
+    }
 
-            // if we get here, the lines either intersect or are collinear.
-            return true;
+    e = ax * cy - ay * cx; // beta numerator
+    // beta tests
+    if (f > 0.0) {
+        if (e < 0.0 || e > f) {
+            return false;
+        }
+    } else {
+        if (e > 0.0 || e < f) {
+            return false;
         }
     }
-    // if we get here we had no intersects
-    return false;
+
+    // if we get here, the lines either intersect or are collinear.
+    return true;
 }
 
 const std::vector<ShapeLine>& Shape::getVec() const
@@ -293,6 +350,31 @@ void Shape::setPosFromCentre()
         sl.x1 -= centreX;
         sl.y1 -= centreY;
     }
+    recalculateBounds();
+}
+
+void Shape::saveStepStart()
+{
+    m_stepStartX = m_isVisible ? std::optional<double>(m_x) : std::nullopt;
+    m_stepStartY = m_isVisible ? std::optional<double>(m_y) : std::nullopt;
+}
+
+double Shape::interpolatedPosX(double alpha) const
+{
+    return m_stepStartX ? *m_stepStartX + (m_x - *m_stepStartX) * alpha : m_x;
+}
+
+double Shape::interpolatedPosY(double alpha) const
+{
+    return m_stepStartY ? *m_stepStartY + (m_y - *m_stepStartY) * alpha : m_y;
+}
+
+BoundingBox Shape::getBounds() const
+{
+    return BoundingBox { m_localBounds.minX + m_x,
+                         m_localBounds.minY + m_y,
+                         m_localBounds.maxX + m_x,
+                         m_localBounds.maxY + m_y };
 }
 
 void Shape::updateShapeSize(double x0, double y0, double x1, double y1)
@@ -327,5 +409,36 @@ void Shape::updateShapeSize(double x0, double y0, double x1, double y1)
     m_height = m_maxY - m_minY;
 }
 
+void Shape::expandBounds(const ShapeLine& sl)
+{
+    m_localBounds.minX = std::min({ m_localBounds.minX, sl.x0, sl.x1 });
+    m_localBounds.minY = std::min({ m_localBounds.minY, sl.y0, sl.y1 });
+    m_localBounds.maxX = std::max({ m_localBounds.maxX, sl.x0, sl.x1 });
+    m_localBounds.maxY = std::max({ m_localBounds.maxY, sl.y0, sl.y1 });
+}
+
+void Shape::recalculateBounds()
+{
+    m_localBounds = BoundingBox();
+    for (const auto& sl : m_shapeLines) {
+        expandBounds(sl);
+    }
+}
+
+void Shape::updatePerpendicular(ShapeLine& sl)
+{
+    // Moving or resizing a line doesn't change this, only rotating it does
+    double dx = sl.x1 - sl.x0;
+    double dy = sl.y1 - sl.y0;
+    double length = std::hypot(dx, dy);
+    if (length == 0.0) {
+        sl.perpendicularX = 0.f;
+        sl.perpendicularY = 0.f;
+        return;
+    }
+    sl.perpendicularX = static_cast<float>(-dy / length);
+    sl.perpendicularY = static_cast<float>(dx / length);
+}
+
 } // namespace amaze
 } // namespace marengo
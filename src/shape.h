@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -19,6 +20,21 @@ struct ShapeLine {
     uint8_t b;
     uint8_t a;
     int lineThickness;
+    // Unit vector at right angles to the line, kept up to date by Shape so
+    // that it needn't be worked out each time the line is drawn
+    float perpendicularX { 0.f };
+    float perpendicularY { 0.f };
+};
+
+// Axis-aligned bounding box
+struct BoundingBox {
+    double minX { std::numeric_limits<double>::max() };
+    double minY { std::numeric_limits<double>::max() };
+    double maxX { std::numeric_limits<double>::lowest() };
+    double maxY { std::numeric_limits<double>::lowest() };
+    // Note an empty box (i.e. one with no lines added) overlaps nothing
+    bool overlaps(const BoundingBox& other, double margin = 0.0) const;
+    bool overlapsLine(double x0, double y0, double x1, double y1, double margin = 0.0) const;
 };
 
 class Shape {
@@ -47,8 +63,27 @@ public:
         int lineThickness);
     void clear();
     bool intersectCheck(std::shared_ptr<Shape>) const;
+    // Line segment intersection test, all coordinates are absolute
+    static bool linesIntersect(
+        double x0,
+        double y0,
+        double x1,
+        double y1,
+        double x2,
+        double y2,
+        double x3,
+        double y3);
     const std::vector<ShapeLine>& getVec() const;
     void setPosFromCentre();
+    // Bounds of all lines in world (i.e. arena) coordinates
+    BoundingBox getBounds() const;
+    // Remembers the position at the start of a simulation step, so that the
+    // shape can be drawn part way between that and where it is now ("alpha"
+    // from 0 to 1). Shapes which aren't visible at the start of the step are
+    // always drawn where they are.
+    void saveStepStart();
+    double interpolatedPosX(double alpha) const;
+    double interpolatedPosY(double alpha) const;
 
 protected:
     std::vector<ShapeLine> m_shapeLines;
@@ -60,6 +95,8 @@ protected:
     int m_rotation { 0 };
     int m_previousRotation { 0 };
     bool m_isVisible { true };
+    std::optional<double> m_stepStartX;
+    std::optional<double> m_stepStartY;
     double m_minX { std::numeric_limits<double>::max() };
     double m_minY { std::numeric_limits<double>::max() };
     double m_maxX { std::numeric_limits<double>::min() };
@@ -69,7 +106,12 @@ protected:
     uint8_t m_g { 255 };
     uint8_t m_b { 255 };
     uint8_t m_a { 255 };
+    // Bounds of the lines as they currently are, relative to m_x, m_y
+    BoundingBox m_localBounds;
     void updateShapeSize(double x0, double y0, double x1, double y1);
+    void expandBounds(const ShapeLine& sl);
+    void recalculateBounds();
+    static void updatePerpendicular(ShapeLine& sl);
 };
 
 } // namespace amaze
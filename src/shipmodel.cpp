@@ -7,13 +7,22 @@
 namespace marengo {
 namespace amaze {
 
+namespace {
+
+// Atmospheric friction, per reference step
+constexpr double friction = 0.9985;
+
+} // namespace
+
 ShipModel::ShipModel(
     std::shared_ptr<GameShape> ship,
     std::shared_ptr<GameShape> flames,
-    std::shared_ptr<GameShape> explosion)
+    std::shared_ptr<GameShape> explosion,
+    utils::Random& random)
     : m_shipGameShape(ship)
     , m_flamesGameShape(flames)
     , m_explosionGameShape(explosion)
+    , m_random(random)
 {
     m_shipGameShape->setColour(192, 192, 255, 255);
     m_shipGameShape->addLine(0, -20, 6, -11, 3);
@@ -62,6 +71,8 @@ double ShipModel::x() const
 void ShipModel::setShipX(double value)
 {
     m_shipX = value;
+    m_previousX = value; // it's been moved, rather than moving
+    m_shipGameShape->setPos(m_shipX, m_shipY);
 }
 
 double ShipModel::y() const
@@ -72,6 +83,8 @@ double ShipModel::y() const
 void ShipModel::setShipY(double value)
 {
     m_shipY = value;
+    m_previousY = value;
+    m_shipGameShape->setPos(m_shipX, m_shipY);
 }
 
 double ShipModel::rotation() const
@@ -170,23 +183,66 @@ float ShipModel::accelerationAmount() const
 void ShipModel::updateShipPosition()
 {
     // atmospheric friction:
-    m_dx *= 0.9985;
-    m_dy *= 0.9985;
+    m_dx *= m_friction;
+    m_dy *= m_friction;
 
     m_velocity = sqrt((m_dx * m_dx) + (m_dy * m_dy));
 
     if (m_isAccelerating) {
-        m_dx = m_dx + utils::sine(m_rotation) * m_accelerationAmount;
-        m_dy = m_dy + utils::cosine(m_rotation) * m_accelerationAmount;
+        m_dx = m_dx + utils::sine(m_rotation) * m_accelerationAmount * m_stepScale;
+        m_dy = m_dy + utils::cosine(m_rotation) * m_accelerationAmount * m_stepScale;
     }
 
     // calculate new position for ship
-    m_shipX = m_shipX - m_dx;
-    m_shipY = m_shipY - m_dy;
+    m_previousX = m_shipX;
+    m_previousY = m_shipY;
+    m_shipX = m_shipX - m_dx * m_stepScale;
+    m_shipY = m_shipY - m_dy * m_stepScale;
+
+    m_shipGameShape->setPos(m_shipX, m_shipY);
+}
 
+double ShipModel::previousX() const
+{
+    return m_previousX;
+}
+
+double ShipModel::previousY() const
+{
+    return m_previousY;
+}
+
+void ShipModel::rewindPosition(double t)
+{
+    m_shipX = m_previousX + (m_shipX - m_previousX) * t;
+    m_shipY = m_previousY + (m_shipY - m_previousY) * t;
     m_shipGameShape->setPos(m_shipX, m_shipY);
 }
 
+void ShipModel::saveStepStart()
+{
+    m_stepStartX = m_shipX;
+    m_stepStartY = m_shipY;
+    m_stepStartRotation = m_rotation;
+}
+
+double ShipModel::interpolatedX(double alpha) const
+{
+    return m_stepStartX + (m_shipX - m_stepStartX) * alpha;
+}
+
+double ShipModel::interpolatedY(double alpha) const
+{
+    return m_stepStartY + (m_shipY - m_stepStartY) * alpha;
+}
+
+double ShipModel::interpolatedRotation(double alpha) const
+{
+    // The short way round, as the rotation wraps at 360 degrees
+    double delta = std::remainder(m_rotation - m_stepStartRotation, 360.0);
+    return m_stepStartRotation + delta * alpha;
+}
+
 void ShipModel::setVisible(bool value)
 {
     m_shipGameShape->setVisible(value);
@@ -202,10 +258,16 @@ std::shared_ptr<GameShape> ShipModel::flamesGameShape() const
     return m_flamesGameShape;
 }
 
+void ShipModel::setStepScale(double stepScale)
+{
+    m_stepScale = stepScale;
+    m_friction = std::pow(friction, stepScale);
+}
+
 void ShipModel::process(bool isExploding)
 {
     // process() is called each game loop by the controlller
-    setRotation(m_rotationDelta);
+    setRotation(m_rotationDelta * m_stepScale);
 
     updateShipPosition();
 
@@ -234,27 +296,27 @@ void ShipModel::drawFlames()
     m_flamesGameShape->clear();
     for (int n = 0; n < 8; ++n) {
         m_flamesGameShape->setColour(180, 0, 0, 255);
-        int bottomY = 22 + static_cast<int>(utils::rnd(50.f) * lengthMultiplier);
+        int bottomY = 22 + static_cast<int>(m_random.rnd(50.f) * lengthMultiplier);
         m_flamesGameShape->addLine(
-            4 - utils::rnd(8), 17, 10 - utils::rnd(20), bottomY, 3);
+            4 - m_random.rnd(8), 17, 10 - m_random.rnd(20), bottomY, 3);
     }
     for (int n = 0; n < 10; ++n) {
         m_flamesGameShape->setColour(255, 0, 0, 255);
-        int bottomY = 22 + static_cast<int>(utils::rnd(40.f) * lengthMultiplier);
+        int bottomY = 22 + static_cast<int>(m_random.rnd(40.f) * lengthMultiplier);
         m_flamesGameShape->addLine(
-            4 - utils::rnd(8), 17, 10 - utils::rnd(20), bottomY, 3);
+            4 - m_random.rnd(8), 17, 10 - m_random.rnd(20), bottomY, 3);
     }
     for (int n = 0; n < 6; ++n) {
         m_flamesGameShape->setColour(250, 214, 116, 255);
-        int bottomY = 22 + static_cast<int>(utils::rnd(30.f) * lengthMultiplier);
+        int bottomY = 22 + static_cast<int>(m_random.rnd(30.f) * lengthMultiplier);
         m_flamesGameShape->addLine(
-            4 - utils::rnd(8), 17, 10 - utils::rnd(20), bottomY, 3);
+            4 - m_random.rnd(8), 17, 10 - m_random.rnd(20), bottomY, 3);
     }
     for (int n = 0; n < 6; ++n) {
         m_flamesGameShape->setColour(255, 255, 255, 255);
-        int bottomY = 22 + static_cast<int>(utils::rnd(20.f) * lengthMultiplier);
+        int bottomY = 22 + static_cast<int>(m_random.rnd(20.f) * lengthMultiplier);
         m_flamesGameShape->addLine(
-            4 - utils::rnd(8), 17, 4 - utils::rnd(8), bottomY, 3);
+            4 - m_random.rnd(8), 17, 4 - m_random.rnd(8), bottomY, 3);
     }
 
     // Ensure that the flames have the same rotation
@@ -270,19 +332,19 @@ void ShipModel::buildExplosionShape()
     m_explosionGameShape->clear();
     // debris:
     for (int n = 0; n < 11; ++n) {
-        if (utils::rnd(3) == 1) {
+        if (m_random.rnd(3) == 1) {
             continue;
         }
-        double x1 = static_cast<double>(sine(n * 30.0) * 20 + (utils::rnd(10)));
-        double y1 = static_cast<double>(cosine(n * 30.0) * 20 + (utils::rnd(10)));
-        double x2 = static_cast<double>(sine((n + 1) * 30.0) * 20 + (utils::rnd(10)));
-        double y2 = static_cast<double>(cosine((n + 1) * 30.0) * 20 + (utils::rnd(10)));
-        uint8_t r = (utils::rnd(128)) + 96;
+        double x1 = static_cast<double>(sine(n * 30.0) * 20 + (m_random.rnd(10)));
+        double y1 = static_cast<double>(cosine(n * 30.0) * 20 + (m_random.rnd(10)));
+        double x2 = static_cast<double>(sine((n + 1) * 30.0) * 20 + (m_random.rnd(10)));
+        double y2 = static_cast<double>(cosine((n + 1) * 30.0) * 20 + (m_random.rnd(10)));
+        uint8_t r = (m_random.rnd(128)) + 96;
         m_explosionGameShape->addShapeLine(ShapeLine { x1, y1, x2, y2, r, r, r, 255, 4 });
     }
     // flames
     for (int n = 0; n < 60; ++n) {
-        if (utils::rnd(3) == 1) {
+        if (m_random.rnd(3) == 1) {
             continue;
         }
         double x1 = static_cast<double>(sine(n * 6.0) * 40);
@@ -295,7 +357,7 @@ void ShipModel::buildExplosionShape()
         x2 = static_cast<double>(sine(n * 6.0) * 60);
         y2 = static_cast<double>(cosine(n * 6.0) * 60);
         m_explosionGameShape->addShapeLine(ShapeLine { x1, y1, x2, y2, 250, 214, 116, 255, 2 });
-        int i = utils::rnd(50);
+        int i = m_random.rnd(50);
         x1 = static_cast<double>(sine(n * 6.0) * 60);
         y1 = static_cast<double>(cosine(n * 6.0) * 60);
         x2 = static_cast<double>(sine(n * 6.0) * (70 + i));
@@ -5,6 +5,7 @@
 
 #include "gameshape.h"
 #include "igraphicsadapter.h"
+#include "utils.h"
 
 namespace marengo {
 namespace amaze {
@@ -14,7 +15,8 @@ public:
     ShipModel(
         std::shared_ptr<GameShape> ship,
         std::shared_ptr<GameShape> flames,
-        std::shared_ptr<GameShape> explosion);
+        std::shared_ptr<GameShape> explosion,
+        utils::Random& random); // the simulation's
 
     // Reset the ship model to a state ready for a new Level:
     void initialise();
@@ -51,6 +53,19 @@ public:
     void setShipY(double value);
 
     void updateShipPosition();
+    // Position before the most recent call to updateShipPosition()
+    double previousX() const;
+    double previousY() const;
+    // Moves the ship back along its most recent step, to a fraction "t"
+    // of the way from its previous position (0.0) to its current one (1.0)
+    void rewindPosition(double t);
+
+    // As Shape::saveStepStart(), for the ship's position and rotation (and
+    // so the camera)
+    void saveStepStart();
+    double interpolatedX(double alpha) const;
+    double interpolatedY(double alpha) const;
+    double interpolatedRotation(double alpha) const;
 
     void setVisible(bool value);
 
@@ -58,6 +73,10 @@ public:
     std::shared_ptr<GameShape> flamesGameShape() const;
     std::shared_ptr<GameShape> explosionGameShape() const;
 
+    // The ship's speeds (and its rotation and acceleration) are per reference
+    // step, and each simulation step moves it "stepScale" of those (see
+    // GameModel::setTickRate())
+    void setStepScale(double stepScale);
     void process(bool isExploding);
     void drawFlames();
     void buildExplosionShape();
@@ -65,18 +84,26 @@ public:
 private:
     double m_rotation { 0.0 };
     double m_rotationDelta { 0.0 };
-    double m_shipX;
-    double m_shipY;
+    double m_shipX { 0.0 };
+    double m_shipY { 0.0 };
+    double m_previousX { 0.0 };
+    double m_previousY { 0.0 };
+    double m_stepStartX { 0.0 };
+    double m_stepStartY { 0.0 };
+    double m_stepStartRotation { 0.0 };
     double m_dx;
     double m_dy;
     double m_velocity { 0.0 };
     double m_maxVelocity;
     bool m_isAccelerating { false };
     float m_accelerationAmount { 0.f };
+    double m_stepScale { 1.0 };
+    double m_friction { 0.9985 }; // per simulation step, see setStepScale()
 
     std::shared_ptr<GameShape> m_shipGameShape;
     std::shared_ptr<GameShape> m_flamesGameShape;
     std::shared_ptr<GameShape> m_explosionGameShape;
+    utils::Random& m_random;
 };
 
 } // namespace amaze
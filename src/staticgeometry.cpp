@@ -0,0 +1,464 @@
+#include "staticgeometry.h"
+#include "exceptions.h"
+
+#include <algorithm>
+
+namespace marengo {
+namespace amaze {
+
+namespace {
+
+// Shape::linesIntersect() truncates coordinates to integers, so allow an
+// extra unit around the probe to be sure we never skip a segment it would
+// report
+constexpr double margin = 1.0;
+
+void expand(BoundingBox& bounds, double x0, double y0, double x1, double y1)
+{
+    bounds.minX = std::min({ bounds.minX, x0, x1 });
+    bounds.minY = std::min({ bounds.minY, y0, y1 });
+    bounds.maxX = std::max({ bounds.maxX, x0, x1 });
+    bounds.maxY = std::max({ bounds.maxY, y0, y1 });
+}
+
+void expand(BoundingBox& bounds, const BoundingBox& other)
+{
+    expand(bounds, other.minX, other.minY, other.maxX, other.maxY);
+}
+
+double cross(double ax, double ay, double bx, double by)
+{
+    return ax * by - ay * bx;
+}
+
+// Returns the fraction t along the path (px, py) + t * (rx, ry) at which it
+// crosses the segment (qx, qy) + u * (sx, sy), if it does so for t and u in
+// [0, 1]. Parallel paths are ignored; when sweeping, the end points of the
+// other segment will catch those.
+std::optional<double> pathCrossing(
+    double px,
+    double py,
+    double rx,
+    double ry,
+    double qx,
+    double qy,
+    double sx,
+    double sy)
+{
+    double denom = cross(rx, ry, sx, sy);
+    if (denom == 0.0) {
+        return std::nullopt;
+    }
+    double t = cross(qx - px, qy - py, sx, sy) / denom;
+    double u = cross(qx - px, qy - py, rx, ry) / denom;
+    if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) {
+        return std::nullopt;
+    }
+    return t;
+}
+
+} // namespace
+
+bool StaticGeometry::isIndexed(GameShapeType type)
+{
+    switch (type) {
+        case GameShapeType::OBSTRUCTION:
+        case GameShapeType::FUEL:
+        case GameShapeType::PRISONER:
+        case GameShapeType::KEY:
+        case GameShapeType::EXIT:
+        case GameShapeType::BREAKABLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool StaticGeometry::isBlocking(GameShapeType type)
+{
+    return type == GameShapeType::OBSTRUCTION || type == GameShapeType::BREAKABLE;
+}
+
+void StaticGeometry::clear()
+{
+    m_shapes.clear();
+    m_nodes.clear();
+    m_x0.clear();
+    m_y0.clear();
+    m_x1.clear();
+    m_y1.clear();
+    m_shapeIndex.clear();
+    m_shapeLeafStart.clear();
+    m_shapeLeaves.clear();
+    m_shapeStamp.clear();
+    m_shapeProbeMask.clear();
+    m_queryStamp = 0;
+}
+
+void StaticGeometry::build(const std::vector<std::shared_ptr<GameShape>>& shapes)
+{
+    clear();
+
+    // Flatten all lines of indexed shapes into absolute coordinates
+    std::vector<BuildSegment> segments;
+    for (const auto& shape : shapes) {
+        if (!isIndexed(shape->getGameShapeType())) {
+            continue;
+        }
+        uint32_t shapeIndex = static_cast<uint32_t>(m_shapes.size());
+        m_shapes.push_back(shape);
+        for (const auto& sl : shape->getVec()) {
+            segments.push_back(
+                { { sl.x0 + shape->getPosX(),
+                    sl.y0 + shape->getPosY(),
+                    sl.x1 + shape->getPosX(),
+                    sl.y1 + shape->getPosY() },
+                  shapeIndex });
+        }
+    }
+    m_shapeStamp.assign(m_shapes.size(), 0);
+    m_shapeProbeMask.assign(m_shapes.size(), 0);
+    if (segments.empty()) {
+        return;
+    }
+
+    // There is one fewer interior node than leaves. Only nodes with more than
+    // m_maxLeafSegments are split (in half), so each leaf has at least half
+    // that many segments.
+    m_nodes.reserve(2 * (segments.size() / (m_maxLeafSegments / 2) + 1));
+    buildNode(segments, m_noParent, 0, static_cast<uint32_t>(segments.size()));
+
+    // The build has reordered the segments so that each leaf's are adjacent
+    m_x0.reserve(segments.size());
+    m_y0.reserve(segments.size());
+    m_x1.reserve(segments.size());
+    m_y1.reserve(segments.size());
+    m_shapeIndex.reserve(segments.size());
+    for (const auto& bs : segments) {
+        m_x0.push_back(bs.segment.x0);
+        m_y0.push_back(bs.segment.y0);
+        m_x1.push_back(bs.segment.x1);
+        m_y1.push_back(bs.segment.y1);
+        m_shapeIndex.push_back(bs.shapeIndex);
+    }
+
+    // The leaves holding each shape's segments, each listed once, so that
+    // removeShape() only has to refit those
+    std::vector<uint32_t> lastLeaf(m_shapes.size(), m_noParent);
+    m_shapeLeafStart.assign(m_shapes.size() + 1, 0);
+    for (uint32_t n = 0; n < m_nodes.size(); ++n) {
+        for (uint32_t i = m_nodes[n].start; i < m_nodes[n].start + m_nodes[n].count; ++i) {
+            if (lastLeaf[m_shapeIndex[i]] != n) {
+                lastLeaf[m_shapeIndex[i]] = n;
+                ++m_shapeLeafStart[m_shapeIndex[i] + 1];
+            }
+        }
+    }
+    for (size_t s = 0; s < m_shapes.size(); ++s) {
+        m_shapeLeafStart[s + 1] += m_shapeLeafStart[s];
+    }
+    m_shapeLeaves.resize(m_shapeLeafStart.back());
+    std::vector<uint32_t> next(m_shapeLeafStart.begin(), m_shapeLeafStart.end() - 1);
+    std::fill(lastLeaf.begin(), lastLeaf.end(), m_noParent);
+    for (uint32_t n = 0; n < m_nodes.size(); ++n) {
+        for (uint32_t i = m_nodes[n].start; i < m_nodes[n].start + m_nodes[n].count; ++i) {
+            if (lastLeaf[m_shapeIndex[i]] != n) {
+                lastLeaf[m_shapeIndex[i]] = n;
+                m_shapeLeaves[next[m_shapeIndex[i]]++] = n;
+            }
+        }
+    }
+
+    refit();
+}
+
+uint32_t StaticGeometry::buildNode(
+    std::vector<BuildSegment>& segments,
+    uint32_t parent,
+    uint32_t first,
+    uint32_t count)
+{
+    uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({ BoundingBox(), first, count, parent, count });
+    if (count <= m_maxLeafSegments) {
+        return nodeIndex;
+    }
+
+    // Split at the median segment centre along the longer axis
+    BoundingBox centres;
+    for (uint32_t n = first; n < first + count; ++n) {
+        const auto& s = segments[n].segment;
+        double cx = (s.x0 + s.x1) / 2.0;
+        double cy = (s.y0 + s.y1) / 2.0;
+        expand(centres, cx, cy, cx, cy);
+    }
+    bool splitX = (centres.maxX - centres.minX) >= (centres.maxY - centres.minY);
+    auto centre = [splitX](const BuildSegment& bs) {
+        return splitX ? bs.segment.x0 + bs.segment.x1 : bs.segment.y0 + bs.segment.y1;
+    };
+    uint32_t half = count / 2;
+    std::nth_element(
+        segments.begin() + first,
+        segments.begin() + first + half,
+        segments.begin() + first + count,
+        [&](const BuildSegment& a, const BuildSegment& b) { return centre(a) < centre(b); });
+
+    m_nodes[nodeIndex].count = 0;
+    buildNode(segments, nodeIndex, first, half); // left child is always nodeIndex + 1
+    uint32_t right = buildNode(segments, nodeIndex, first + half, count - half);
+    m_nodes[nodeIndex].start = right;
+    return nodeIndex;
+}
+
+void StaticGeometry::refit()
+{
+    // Children always come after their parent, so working backwards means
+    // each node's children are up to date by the time we reach it
+    for (uint32_t n = static_cast<uint32_t>(m_nodes.size()); n-- > 0;) {
+        if (m_nodes[n].count > 0) {
+            refitLeaf(n);
+        } else {
+            refitInterior(n);
+        }
+    }
+}
+
+void StaticGeometry::refitLeaf(uint32_t nodeIndex)
+{
+    Node& node = m_nodes[nodeIndex];
+    node.bounds = BoundingBox();
+    node.liveCount = 0;
+    for (uint32_t n = node.start; n < node.start + node.count; ++n) {
+        if (m_shapes[m_shapeIndex[n]]->IsActive()) {
+            expand(node.bounds, m_x0[n], m_y0[n], m_x1[n], m_y1[n]);
+            ++node.liveCount;
+        }
+    }
+}
+
+void StaticGeometry::refitInterior(uint32_t nodeIndex)
+{
+    const Node& left = m_nodes[nodeIndex + 1];
+    const Node& right = m_nodes[m_nodes[nodeIndex].start];
+    Node& node = m_nodes[nodeIndex];
+    node.liveCount = left.liveCount + right.liveCount;
+    node.bounds = BoundingBox();
+    if (left.liveCount > 0) {
+        expand(node.bounds, left.bounds);
+    }
+    if (right.liveCount > 0) {
+        expand(node.bounds, right.bounds);
+    }
+}
+
+void StaticGeometry::refitParents(uint32_t nodeIndex)
+{
+    for (uint32_t n = m_nodes[nodeIndex].parent; n != m_noParent; n = m_nodes[n].parent) {
+        refitInterior(n);
+    }
+}
+
+void StaticGeometry::removeShape(const GameShape* shape)
+{
+    auto it = std::find_if(m_shapes.begin(), m_shapes.end(), [shape](const auto& s) {
+        return s.get() == shape;
+    });
+    if (it == m_shapes.end()) {
+        return;
+    }
+    size_t shapeIndex = it - m_shapes.begin();
+    for (uint32_t n = m_shapeLeafStart[shapeIndex]; n < m_shapeLeafStart[shapeIndex + 1]; ++n) {
+        refitLeaf(m_shapeLeaves[n]);
+        refitParents(m_shapeLeaves[n]);
+    }
+}
+
+bool StaticGeometry::startTraversal() const
+{
+    m_stack.clear();
+    if (m_nodes.empty() || m_nodes[0].liveCount == 0) {
+        return false;
+    }
+    m_stack.push_back(0);
+    return true;
+}
+
+void StaticGeometry::query(std::span<const Shape* const> probes, std::vector<ProbeHit>& hits) const
+{
+    if (probes.size() > m_maxProbes) {
+        THROWUP(AmazeRuntimeException, "Too many probes for a static geometry query");
+    }
+
+    // Gather every probe's lines, in absolute coordinates, up front. Probes
+    // with no lines are skipped but keep their index.
+    BoundingBox allBounds;
+    m_probeBounds.clear();
+    m_probeSegments.clear();
+    m_probeFirstSegment.clear();
+    for (const Shape* probe : probes) {
+        m_probeFirstSegment.push_back(static_cast<uint32_t>(m_probeSegments.size()));
+        m_probeBounds.push_back(probe->getBounds());
+        if (probe->getVec().empty()) {
+            continue;
+        }
+        expand(allBounds, m_probeBounds.back());
+        for (const auto& sl : probe->getVec()) {
+            m_probeSegments.push_back({ sl.x0 + probe->getPosX(),
+                                        sl.y0 + probe->getPosY(),
+                                        sl.x1 + probe->getPosX(),
+                                        sl.y1 + probe->getPosY() });
+        }
+    }
+    m_probeFirstSegment.push_back(static_cast<uint32_t>(m_probeSegments.size()));
+    if (m_probeSegments.empty() || !startTraversal()) {
+        return;
+    }
+
+    ++m_queryStamp;
+    if (m_queryStamp == 0) {
+        // wrapped around, so old stamps could match again
+        std::fill(m_shapeStamp.begin(), m_shapeStamp.end(), 0);
+        m_queryStamp = 1;
+    }
+    if (m_kernelHits.size() < m_maxLeafSegments) {
+        m_kernelHits.resize(m_maxLeafSegments);
+    }
+
+    while (!m_stack.empty()) {
+        uint32_t nodeIndex = m_stack.back();
+        m_stack.pop_back();
+        const Node& node = m_nodes[nodeIndex];
+        if (node.liveCount == 0 || !node.bounds.overlaps(allBounds, margin)) {
+            continue;
+        }
+        if (node.count == 0) {
+            m_stack.push_back(node.start);
+            m_stack.push_back(nodeIndex + 1);
+            continue;
+        }
+        for (uint32_t p = 0; p < probes.size(); ++p) {
+            if (!node.bounds.overlaps(m_probeBounds[p], margin)) {
+                continue;
+            }
+            for (uint32_t i = m_probeFirstSegment[p]; i < m_probeFirstSegment[p + 1]; ++i) {
+                const auto& ps = m_probeSegments[i];
+                if (!node.bounds.overlapsLine(ps.x0, ps.y0, ps.x1, ps.y1, margin)) {
+                    continue;
+                }
+                size_t hitCount = m_kernel(
+                    ps,
+                    m_x0.data() + node.start,
+                    m_y0.data() + node.start,
+                    m_x1.data() + node.start,
+                    m_y1.data() + node.start,
+                    node.count,
+                    m_kernelHits.data());
+                for (size_t h = 0; h < hitCount; ++h) {
+                    uint32_t shapeIndex = m_shapeIndex[node.start + m_kernelHits[h]];
+                    if (m_shapeStamp[shapeIndex] != m_queryStamp) {
+                        m_shapeStamp[shapeIndex] = m_queryStamp;
+                        m_shapeProbeMask[shapeIndex] = 0;
+                    }
+                    uint32_t probeBit = 1u << p;
+                    if (m_shapeProbeMask[shapeIndex] & probeBit) {
+                        continue; // already reported this shape for this probe
+                    }
+                    const GameShape* shape = m_shapes[shapeIndex].get();
+                    if (shape->IsActive()) {
+                        m_shapeProbeMask[shapeIndex] |= probeBit;
+                        hits.push_back({ p, shape });
+                    }
+                }
+            }
+        }
+    }
+}
+
+void StaticGeometry::sweep(
+    const Shape& probe,
+    double fromX,
+    double fromY,
+    std::vector<SweepHit>& hits) const
+{
+    // For a translating segment, first contact with a stationary one always
+    // happens at an end point of one of them. So it's enough to check the paths
+    // of each of the probe's end points against the walls and, relative to the
+    // probe, the paths of each wall's end points against the probe's lines.
+    hits.clear();
+    const auto& probeLines = probe.getVec();
+    double dx = probe.getPosX() - fromX;
+    double dy = probe.getPosY() - fromY;
+    if (probeLines.empty() || (dx == 0.0 && dy == 0.0) || !startTraversal()) {
+        return;
+    }
+
+    BoundingBox swept = probe.getBounds();
+    expand(swept, swept.minX - dx, swept.minY - dy, swept.maxX - dx, swept.maxY - dy);
+
+    // Each shape is reported once, at the time it was first touched. There
+    // are rarely more than one or two, so they're just searched.
+    auto consider = [&](std::optional<double> t, uint32_t shapeIndex) {
+        if (!t.has_value()) {
+            return;
+        }
+        const GameShape* shape = m_shapes[shapeIndex].get();
+        auto it = std::find_if(hits.begin(), hits.end(), [shape](const SweepHit& hit) {
+            return hit.shape == shape;
+        });
+        if (it == hits.end()) {
+            hits.push_back({ shape, *t });
+        } else {
+            it->time = std::min(it->time, *t);
+        }
+    };
+    while (!m_stack.empty()) {
+        uint32_t nodeIndex = m_stack.back();
+        m_stack.pop_back();
+        const Node& node = m_nodes[nodeIndex];
+        if (node.liveCount == 0 || !node.bounds.overlaps(swept, margin)) {
+            continue;
+        }
+        if (node.count == 0) {
+            m_stack.push_back(node.start);
+            m_stack.push_back(nodeIndex + 1);
+            continue;
+        }
+        for (uint32_t n = node.start; n < node.start + node.count; ++n) {
+            if (!m_shapes[m_shapeIndex[n]]->IsActive()
+                || !swept.overlapsLine(m_x0[n], m_y0[n], m_x1[n], m_y1[n], margin)) {
+                continue;
+            }
+            double wx0 = m_x0[n];
+            double wy0 = m_y0[n];
+            double wx = m_x1[n] - wx0;
+            double wy = m_y1[n] - wy0;
+            uint32_t shapeIndex = m_shapeIndex[n];
+            for (const auto& sl : probeLines) {
+                // Probe's line at the start of the sweep
+                double lx0 = sl.x0 + fromX;
+                double ly0 = sl.y0 + fromY;
+                double lx = sl.x1 - sl.x0;
+                double ly = sl.y1 - sl.y0;
+                consider(pathCrossing(lx0, ly0, dx, dy, wx0, wy0, wx, wy), shapeIndex);
+                consider(pathCrossing(lx0 + lx, ly0 + ly, dx, dy, wx0, wy0, wx, wy), shapeIndex);
+                consider(pathCrossing(wx0, wy0, -dx, -dy, lx0, ly0, lx, ly), shapeIndex);
+                consider(pathCrossing(wx0 + wx, wy0 + wy, -dx, -dy, lx0, ly0, lx, ly), shapeIndex);
+            }
+        }
+    }
+
+    // e.g. fuel picked up on the way to a wall counts, but not the exit
+    // on the far side of it
+    std::sort(hits.begin(), hits.end(), [](const SweepHit& a, const SweepHit& b) {
+        return a.time < b.time;
+    });
+    auto blocking = std::find_if(hits.begin(), hits.end(), [](const SweepHit& hit) {
+        return isBlocking(hit.shape->getGameShapeType());
+    });
+    if (blocking != hits.end()) {
+        hits.erase(blocking + 1, hits.end());
+    }
+}
+
+} // namespace amaze
+} // namespace marengo
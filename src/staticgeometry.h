@@ -0,0 +1,129 @@
+#pragma once
+
+#include "gameshape.h"
+#include "segmentkernel.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Collision index for level geometry which never moves (i.e. everything
+// loaded from the level file except MOVING objects). It is built once per
+// Level load and lets the model test the ship (and flames) against only the
+// line segments which are near it, rather than against every line in the
+// Level.
+//
+// The index is a bounding volume hierarchy over all the static segments,
+// built by splitting at the median along the longest axis. It is flattened
+// into a single array of nodes in depth first order (so a node's left child
+// immediately follows it). Each leaf covers a contiguous run of segments,
+// stored with each coordinate in its own array so that a leaf can be handed
+// to a SIMD segment kernel (see segmentkernel.h) in one go.
+//
+// Shapes which are deactivated (e.g. breakables once hit) can be removed
+// without rebuilding: the affected nodes are refitted and any subtree with
+// no remaining live segments is skipped.
+
+namespace marengo {
+namespace amaze {
+
+struct SweepHit {
+    const GameShape* shape;
+    double time; // 0.0 is the start of the sweep, 1.0 the end
+};
+
+struct ProbeHit {
+    uint32_t probe; // index into the probes passed to the query
+    const GameShape* shape;
+};
+
+class StaticGeometry {
+public:
+    // Returns true if shapes of this type are held in the static index (and so
+    // should not be tested separately by the caller)
+    static bool isIndexed(GameShapeType type);
+    // Returns true if the ship can't pass through shapes of this type, e.g.
+    // walls, as opposed to fuel or the exit
+    static bool isBlocking(GameShapeType type);
+
+    void clear();
+    void build(const std::vector<std::shared_ptr<GameShape>>& shapes);
+
+    // Appends to "hits" each (active) indexed shape which has at least one line
+    // intersecting any of the probes' lines, testing all the probes in a single
+    // traversal. There is one hit per (probe, shape) pair. At most m_maxProbes
+    // probes may be given.
+    void query(std::span<const Shape* const> probes, std::vector<ProbeHit>& hits) const;
+
+    // Continuous collision test: treats the probe as having moved in a straight
+    // line from (fromX, fromY) to its current position, and fills "hits" with
+    // each (active) indexed shape it touched on the way, in the order touched.
+    // Nothing after the first blocking shape is included, as the probe would
+    // never have got that far. Any rotation during the move is ignored, i.e.
+    // the probe is swept in its current orientation.
+    void sweep(const Shape& probe, double fromX, double fromY, std::vector<SweepHit>& hits) const;
+
+    // Removes an indexed shape's segments from the hierarchy. Call this when
+    // a shape is deactivated.
+    void removeShape(const GameShape* shape);
+    // Brings the whole hierarchy up to date with the shapes' IsActive() flags,
+    // e.g. if shapes have been re-activated.
+    void refit();
+
+private:
+    struct Node {
+        BoundingBox bounds;
+        uint32_t start; // leaf: index of first segment, otherwise index of right child
+        uint32_t count; // leaf: number of segments, otherwise zero
+        uint32_t parent;
+        uint32_t liveCount; // number of segments below here belonging to active shapes
+    };
+
+    struct BuildSegment {
+        segmentkernel::Segment segment;
+        uint32_t shapeIndex;
+    };
+
+    uint32_t
+    buildNode(std::vector<BuildSegment>& segments, uint32_t parent, uint32_t first, uint32_t count);
+    void refitLeaf(uint32_t nodeIndex);
+    void refitInterior(uint32_t nodeIndex);
+    void refitParents(uint32_t nodeIndex);
+    // Pushes the root onto m_stack if there's anything to search
+    bool startTraversal() const;
+
+    static constexpr uint32_t m_maxLeafSegments { 8 };
+    static constexpr uint32_t m_noParent { UINT32_MAX };
+    static constexpr uint32_t m_maxProbes { 32 }; // bits in m_shapeProbeMask
+
+    std::vector<std::shared_ptr<GameShape>> m_shapes;
+    std::vector<Node> m_nodes;
+
+    // Segments, in hierarchy order
+    std::vector<double> m_x0;
+    std::vector<double> m_y0;
+    std::vector<double> m_x1;
+    std::vector<double> m_y1;
+    std::vector<uint32_t> m_shapeIndex;
+    // Shape n's leaves are m_shapeLeaves[m_shapeLeafStart[n]] up to (but not
+    // including) m_shapeLeaves[m_shapeLeafStart[n + 1]]
+    std::vector<uint32_t> m_shapeLeafStart;
+    std::vector<uint32_t> m_shapeLeaves;
+
+    segmentkernel::KernelFn m_kernel { segmentkernel::bestKernel() };
+    mutable std::vector<uint32_t> m_kernelHits;
+    mutable std::vector<uint32_t> m_stack;
+    mutable std::vector<segmentkernel::Segment> m_probeSegments;
+    mutable std::vector<uint32_t> m_probeFirstSegment;
+    mutable std::vector<BoundingBox> m_probeBounds;
+
+    // Used to avoid reporting a shape more than once per probe per query
+    mutable std::vector<uint32_t> m_shapeStamp;
+    mutable std::vector<uint32_t> m_shapeProbeMask; // valid if the stamp is current
+    mutable uint32_t m_queryStamp { 0 };
+};
+
+} // namespace amaze
+} // namespace marengo
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Hands values from one producer thread to one consumer thread without
+// either ever blocking the other. There are three slots: the producer fills
+// its "back" slot and publishes it, swapping it with the shared middle slot;
+// the consumer swaps the middle slot with its "front" slot whenever a newer
+// one has been published. So the consumer always gets the newest complete
+// value, and values it was too slow to see are simply overwritten.
+
+namespace marengo {
+namespace amaze {
+
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer side
+    T& back()
+    {
+        return m_slots[m_back];
+    }
+    void publish()
+    {
+        unsigned previous = m_middle.exchange(m_back | m_newBit, std::memory_order_acq_rel);
+        m_back = previous & m_indexMask;
+        m_middle.notify_one();
+    }
+
+    // Consumer side
+    const T& front() const
+    {
+        return m_slots[m_front];
+    }
+    // Makes the newest published value the front one. Returns false if
+    // nothing has been published since the last call.
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & m_newBit) == 0) {
+            return false;
+        }
+        unsigned previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & m_indexMask;
+        return true;
+    }
+    // Blocks until there is something newer than front()
+    void waitForNew() const
+    {
+        for (;;) {
+            unsigned middle = m_middle.load(std::memory_order_acquire);
+            if (middle & m_newBit) {
+                return;
+            }
+            m_middle.wait(middle, std::memory_order_acquire);
+        }
+    }
+
+private:
+    static constexpr unsigned m_indexMask { 3 };
+    static constexpr unsigned m_newBit { 4 };
+
+    std::array<T, 3> m_slots {};
+    unsigned m_back { 0 }; // only used by the producer
+    unsigned m_front { 2 }; // only used by the consumer
+    // Index of the middle slot, plus m_newBit if it hasn't been consumed yet
+    std::atomic<unsigned> m_middle { 1 };
+};
+
+} // namespace amaze
+} // namespace marengo
@@ -2,7 +2,6 @@
 
 #include "boost/math/constants/constants.hpp"
 
-#include <random>
 #include <string>
 
 namespace marengo {
@@ -49,17 +48,6 @@ double sine(double degrees)
     return std::sin(degrees * (bmc::two_pi<double>() / 360.0));
 }
 
-uint8_t rnd(uint8_t max)
-{
-    if (max < 2) {
-        return 0;
-    }
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(0, max - 1);
-    return distrib(gen);
-}
-
 } // namespace helperfunctions
 } // namespace amaze
 } // namespace marengo
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <random>
+#include <type_traits>
 #include <vector>
 
 namespace marengo {
@@ -11,25 +13,54 @@ void csvSplit(const std::string& s, char c, std::vector<std::string>& v);
 void csvSplit(const std::string& s, char c, std::vector<double>& v);
 double sine(double degrees);
 double cosine(double degrees);
-uint8_t rnd(uint8_t max); // return random integer from range [0-max)
-template <typename T> T rnd(T max)
-{
-    if (max <= T(0)) {
-        return T(0);
+
+// A random number generator with its own state. Anything which must be
+// repeatable (i.e. the simulation) has its own, seeded explicitly, so the
+// numbers it gets don't depend on anything else using random numbers.
+class Random {
+public:
+    Random()
+        : m_gen(std::random_device {}())
+    {
+    }
+    explicit Random(uint32_t seed)
+        : m_gen(seed)
+    {
+    }
+    void seed(uint32_t seed)
+    {
+        m_gen.seed(seed);
     }
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    if constexpr (std::is_floating_point_v<T>) {
-        std::uniform_real_distribution<T> distrib(T(0), max);
-        return distrib(gen);
-    } else {
-        if (max < T(2)) {
+    // Returns a random number from the range [0-max). The mapping from the
+    // generator's output is done here rather than by the std distributions,
+    // whose algorithms differ between standard libraries, so a given seed
+    // produces the same numbers whichever library is used. (Replays still
+    // need the same build to reproduce: the simulation also depends on libm's
+    // sin() and cos() and on the compiler's floating point settings.)
+    template <typename T> T rnd(T max)
+    {
+        static_assert(std::mt19937::max() == 0xFFFFFFFFu, "expects 32-bit output");
+        if (max <= T(0)) {
             return T(0);
         }
-        std::uniform_int_distribution<T> distrib(T(0), max - T(1));
-        return distrib(gen);
+        if constexpr (std::is_floating_point_v<T>) {
+            if constexpr (std::is_same_v<T, float>) {
+                return static_cast<float>(m_gen() >> 8) * 0x1p-24f * max;
+            } else {
+                return static_cast<T>(m_gen()) * T(0x1p-32) * max;
+            }
+        } else {
+            // Multiply-shift: scales [0, 2^32) onto [0, max)
+            static_assert(sizeof(T) <= sizeof(uint32_t), "max must fit in 32 bits");
+            uint64_t scaled = uint64_t(m_gen()) * static_cast<uint32_t>(max);
+            return static_cast<T>(scaled >> 32);
+        }
     }
-}
+
+private:
+    std::mt19937 m_gen;
+};
+
 template <typename T>
     requires std::integral<T> || std::floating_point<T>
 int sgn(T x)
@@ -43,9 +74,11 @@ int sgn(T x)
     return 0;
 }
 
-template <typename T, std::size_t N> class RingBuffer {
+template <typename T> class RingBuffer {
 public:
-    RingBuffer()
+    // Holds the most recent "capacity" items
+    explicit RingBuffer(std::size_t capacity)
+        : m_buffer(capacity + 1)
     {
         clear();
     }
@@ -70,14 +103,12 @@ public:
     }
 
 private:
-    static const std::size_t BUFSIZE = N + 1;
-
     void advance(std::size_t& ptr)
     {
-        ptr = (ptr + 1) % BUFSIZE;
+        ptr = (ptr + 1) % m_buffer.size();
     }
 
-    T m_buffer[BUFSIZE];
+    std::vector<T> m_buffer;
     std::size_t m_head;
     std::size_t m_tail;
 };
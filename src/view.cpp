@@ -1,13 +1,42 @@
 #include "view.h"
+#include "cameratransform.h"
 #include "shape.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 namespace marengo {
 namespace amaze {
 
+namespace {
+
+// Allowance (in units) for line thickness when culling
+constexpr double lineMargin = 8.0;
+
+// The background grid covers the arena, with lines every 50 units
+constexpr double gridSpacing = 50.0;
+constexpr double gridExtent = 2000.0;
+constexpr double gridLineThickness = 4.0;
+
+// Squared distance from (px, py) to the line segment (x0, y0) - (x1, y1)
+double distanceSquaredToSegment(double px, double py, double x0, double y0, double x1, double y1)
+{
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (lengthSquared > 0.0) {
+        t = std::clamp(((px - x0) * dx + (py - y0) * dy) / lengthSquared, 0.0, 1.0);
+    }
+    double ex = px - (x0 + t * dx);
+    double ey = py - (y0 + t * dy);
+    return ex * ex + ey * ey;
+}
+
+} // namespace
+
 View::View(GameModel& model, IGraphicsAdapter& gm)
     : m_model(model)
     , m_graphicsAdapter(gm)
@@ -35,7 +64,7 @@ void View::stopSounds()
     m_graphicsAdapter.soundFade("rocket", 400);
 }
 
-void View::update()
+void View::update(double alpha)
 {
     // TODO: this should take a model as its parameter; we shouldn't be bound
     // to one model but should be able to accept any model implementing a
@@ -45,12 +74,34 @@ void View::update()
     // This is where all state is "realised" e.g. images drawn, sounds played
     playSounds();
 
-    // Dynamic shapes (i.e. shapes which rotate around the ship)
-    for (const auto& shape : m_model.getAllDynamicObjects()) {
-        if (shape->isVisible() && shape->IsActive()) {
-            rotateAndDrawShape(*shape);
+    // The static layer's count lasts until it is next rebuilt
+    m_renderStats = RenderStats { .staticLines = m_renderStats.staticLines };
+    m_alpha = alpha;
+    m_camera = camera();
+
+    // After a resize, lines are a different width on screen (so the static
+    // layer needs rebuilding) and any backdrop is the wrong size
+    std::pair windowSize { m_graphicsAdapter.getWindoWidth(), m_graphicsAdapter.getWindowHeight() };
+    if (windowSize != m_windowSize) {
+        m_windowSize = windowSize;
+        m_staticLayerGeneration.reset();
+        m_backdropCaptured = false;
+    }
+
+    // When dimmed (e.g. in the menu) nothing in the world moves, so it's drawn
+    // once, as the state changes, and kept by the graphics adapter as a
+    // backdrop to draw the menu over
+    bool dimmed = m_model.getGameState() == GameState::Menu
+        || m_model.getGameState() == GameState::Paused;
+    if (dimmed && m_backdropCaptured) {
+        m_graphicsAdapter.drawBackdrop();
+    } else {
+        drawWorld();
+        if (dimmed) {
+            m_graphicsAdapter.captureBackdrop(0.4f);
         }
     }
+    m_backdropCaptured = dimmed;
 
     // Draw black rectangle at top of screen for status bar (and hiding the "notch" on
     // macs in full screen)
@@ -65,6 +116,16 @@ void View::update()
     t.text = "Ships remaining: " + std::to_string(m_model.getLivesRemaining());
     m_graphicsAdapter.drawText(t);
 
+    if (m_model.getGameState() == GameState::Running && m_model.shipProximity() > 0.5) {
+        Text pw;
+        pw.r = 255;
+        pw.g = 160;
+        pw.characterSize = 40;
+        pw.positionY = 20;
+        pw.text = "Proximity warning";
+        m_graphicsAdapter.drawText(pw);
+    }
+
     if (m_model.gameIsPaused()) {
         Text pm;
         pm.r = 255;
@@ -86,6 +147,16 @@ void View::update()
         m_graphicsAdapter.drawText(pm);
     }
 
+    if (m_model.getGameState() == GameState::Respawning) {
+        Text pm;
+        pm.r = 255;
+        pm.g = 255;
+        pm.characterSize = 160;
+        pm.text = std::to_string(m_model.getRespawnCountdown());
+        pm.positionY = m_graphicsAdapter.getWindowHeight() * 0.3;
+        m_graphicsAdapter.drawText(pm);
+    }
+
     if (m_model.getGameState() == GameState::Dead && m_model.getLivesRemaining() == 0) {
         Text pm;
         pm.r = 255;
@@ -101,54 +172,188 @@ void View::update()
     }
 }
 
-void View::rotateAndDrawShape(const GameShape& shape) const
+const RenderStats& View::renderStats() const
+{
+    return m_renderStats;
+}
+
+void View::drawWorld()
+{
+    drawGrid();
+
+    // Static shapes are held by the graphics adapter in world coordinates, and
+    // just need the camera for this frame
+    if (m_model.levelGeneration() != m_staticLayerGeneration) {
+        buildStaticLayer();
+    } else if (m_model.staticShapesVersion() != m_staticLayerVersion) {
+        updateStaticLayer();
+    }
+    m_graphicsAdapter.drawStaticLines(m_camera);
+
+    // Dynamic shapes (i.e. shapes which rotate around the ship). The corners
+    // of their lines are gathered in world coordinates and then all
+    // transformed to the screen in one go.
+    m_quads.clear();
+    m_pointsX.clear();
+    m_pointsY.clear();
+    for (const auto& shape : m_model.getAllDynamicObjects()) {
+        if (GameModel::isStaticShape(*shape)) {
+            continue;
+        }
+        if (shape->isVisible() && shape->IsActive()) {
+            rotateAndDrawShape(*shape);
+        }
+    }
+    m_transform(
+        cameratransform::fromCamera(m_camera),
+        m_pointsX.data(),
+        m_pointsY.data(),
+        m_pointsX.size());
+    for (size_t n = 0; n < m_quads.size(); ++n) {
+        for (size_t corner = 0; corner < 4; ++corner) {
+            m_quads[n].x[corner] = m_pointsX[4 * n + corner];
+            m_quads[n].y[corner] = m_pointsY[4 * n + corner];
+        }
+    }
+    m_graphicsAdapter.drawLineQuads(m_quads);
+}
+
+Camera View::camera() const
 {
     // We treat the viewport as representing 480 coordinate units wide,
-    // regardless of its physical dimensions:
-    double scale = m_graphicsAdapter.getWindoWidth() / 480.0;
-    double xOffset = m_graphicsAdapter.getWindoWidth() / 2.0;
-    double yOffset = m_graphicsAdapter.getWindowHeight() / 2.0;
+    // regardless of its physical dimensions, with the ship in the centre
+    return { m_model.getShipModel()->interpolatedX(m_alpha),
+             m_model.getShipModel()->interpolatedY(m_alpha),
+             m_model.getShipModel()->interpolatedRotation(m_alpha),
+             m_graphicsAdapter.getWindoWidth() / 480.0,
+             m_graphicsAdapter.getWindoWidth() / 2.0,
+             m_graphicsAdapter.getWindowHeight() / 2.0 };
+}
 
-    for (const auto& sl : shape.getVec()) {
-        double x0 = sl.x0 + shape.getPosX() - m_model.getShipModel()->x();
-        double y0 = sl.y0 + shape.getPosY() - m_model.getShipModel()->y();
-        double x1 = sl.x1 + shape.getPosX() - m_model.getShipModel()->x();
-        double y1 = sl.y1 + shape.getPosY() - m_model.getShipModel()->y();
-        // OK, when we get here, we have a line expressed
-        // relative to the origin OF THE SHIP.
-        double dCos = utils::cosine(m_model.getShipModel()->rotation());
-        double dSin = utils::sine(m_model.getShipModel()->rotation());
-        double x0r, y0r, x1r, y1r;
-        x0r = x0 * dCos - y0 * dSin;
-        y0r = x0 * dSin + y0 * dCos;
-        x1r = x1 * dCos - y1 * dSin;
-        y1r = x1 * dSin + y1 * dCos;
-        // now draw adjusted for physical screen coords
+void View::drawGrid()
+{
+    // Line widths are given in world units, so will be scaled back up by the
+    // camera
+    Grid grid { gridSpacing,
+                gridExtent,
+                gridLineThickness * m_graphicsAdapter.getScalingFactor() / m_camera.scale,
+                0,
+                32,
+                0 };
+    m_graphicsAdapter.drawGrid(grid, m_camera);
+}
+
+void View::buildStaticLayer()
+{
+    // Line widths are given in world units, so will be scaled back up by the
+    // camera
+    double widthScale = m_graphicsAdapter.getScalingFactor() / camera().scale;
+    m_lines.clear();
+    m_staticShapeLines.clear();
+    for (const auto& shape : m_model.getAllDynamicObjects()) {
+        if (!GameModel::isStaticShape(*shape) || !shape->isVisible()) {
+            continue;
+        }
+        m_staticShapeLines.push_back(
+            { shape.get(), m_lines.size(), shape->getVec().size(), true });
+        for (const auto& sl : shape->getVec()) {
+            m_lines.push_back({ static_cast<float>(sl.x0 + shape->getPosX()),
+                                static_cast<float>(sl.y0 + shape->getPosY()),
+                                static_cast<float>(sl.x1 + shape->getPosX()),
+                                static_cast<float>(sl.y1 + shape->getPosY()),
+                                static_cast<float>(sl.lineThickness * widthScale),
+                                sl.r,
+                                sl.g,
+                                sl.b });
+        }
+    }
+    m_graphicsAdapter.setStaticLines(m_lines);
+    m_renderStats.staticLines = m_lines.size();
+    m_staticLayerGeneration = m_model.levelGeneration();
+    updateStaticLayer();
+}
+
+void View::updateStaticLayer()
+{
+    // The shapes are the model's for as long as its Level generation is
+    // unchanged, so are still there
+    for (auto& lines : m_staticShapeLines) {
+        if (lines.shape->IsActive() == lines.shown) {
+            continue;
+        }
+        lines.shown = !lines.shown;
+        m_graphicsAdapter.setStaticLinesShown(lines.first, lines.count, lines.shown);
+        if (lines.shown) {
+            m_renderStats.staticLines += lines.count;
+        } else {
+            m_renderStats.staticLines -= lines.count;
+        }
+    }
+    m_staticLayerVersion = m_model.staticShapesVersion();
+}
+
+void View::rotateAndDrawShape(const GameShape& shape)
+{
+    // Whatever the rotation, everything visible is within the circle around
+    // the ship which encloses the screen, so anything outside that is culled
+    // before doing any more work
+    const auto& lines = shape.getVec();
+    if (lines.empty()) {
+        return;
+    }
+    double shipX = m_camera.centreX;
+    double shipY = m_camera.centreY;
+    double cullRadius
+        = std::hypot(m_camera.offsetX, m_camera.offsetY) / m_camera.scale + lineMargin;
+    BoundingBox bounds = shape.getBounds();
+    double nearestX = std::clamp(shipX, bounds.minX, bounds.maxX);
+    double nearestY = std::clamp(shipY, bounds.minY, bounds.maxY);
+    if (std::hypot(nearestX - shipX, nearestY - shipY) > cullRadius) {
+        ++m_renderStats.shapesCulled;
+        m_renderStats.linesCulled += lines.size();
+        return;
+    }
+    // Line widths are in pixels (at 1080 lines), so are converted to world
+    // units, which the camera will scale back up
+    double halfWidthScale = m_graphicsAdapter.getScalingFactor() / m_camera.scale / 2.0;
+
+    // Drawn part way between where it was at the start of the latest
+    // simulation step and where it is now
+    double posX = shape.interpolatedPosX(m_alpha);
+    double posY = shape.interpolatedPosY(m_alpha);
+
+    double cullRadiusSquared = cullRadius * cullRadius;
+    for (const auto& sl : lines) {
+        double x0 = sl.x0 + posX;
+        double y0 = sl.y0 + posY;
+        double x1 = sl.x1 + posX;
+        double y1 = sl.y1 + posY;
+        if (distanceSquaredToSegment(shipX, shipY, x0, y0, x1, y1) > cullRadiusSquared) {
+            ++m_renderStats.linesCulled;
+            continue;
+        }
+        ++m_renderStats.linesDrawn;
         uint8_t r = sl.r;
         uint8_t g = sl.g;
         uint8_t b = sl.b;
         // Special case for objects with gravity, we add random colours
         if (shape.getGravity() != 0.f) {
-            r = utils::rnd(193);
-            g = utils::rnd(193);
-            r = utils::rnd(193);
-        }
-        if (m_model.getGameState() == GameState::Menu
-            || m_model.getGameState() == GameState::Paused) {
-            // Dim everything
-            r *= 0.4;
-            g *= 0.4;
-            b *= 0.4;
+            r = m_random.rnd(193);
+            g = m_random.rnd(193);
+            r = m_random.rnd(193);
         }
-        m_graphicsAdapter.drawLine(
-            x0r * scale + xOffset,
-            y0r * scale + yOffset,
-            x1r * scale + xOffset,
-            y1r * scale + yOffset,
-            sl.lineThickness * m_graphicsAdapter.getScalingFactor(),
-            r,
-            g,
-            b);
+        // The corners are transformed to screen coordinates by update()
+        double offsetX = sl.perpendicularX * sl.lineThickness * halfWidthScale;
+        double offsetY = sl.perpendicularY * sl.lineThickness * halfWidthScale;
+        m_pointsX.push_back(static_cast<float>(x0 + offsetX));
+        m_pointsX.push_back(static_cast<float>(x1 + offsetX));
+        m_pointsX.push_back(static_cast<float>(x1 - offsetX));
+        m_pointsX.push_back(static_cast<float>(x0 - offsetX));
+        m_pointsY.push_back(static_cast<float>(y0 + offsetY));
+        m_pointsY.push_back(static_cast<float>(y1 + offsetY));
+        m_pointsY.push_back(static_cast<float>(y1 - offsetY));
+        m_pointsY.push_back(static_cast<float>(y0 - offsetY));
+        m_quads.push_back({ {}, {}, r, g, b });
     }
 }
 
@@ -1,5 +1,12 @@
 #pragma once
+#include "cameratransform.h"
 #include "gamemodel.h"
+#include "igraphicsadapter.h"
+#include "utils.h"
+
+#include <optional>
+#include <utility>
+#include <vector>
 
 // This class acts as the MVC "view" component - its function is to
 // update the display according to the state held within the model.
@@ -13,18 +20,66 @@
 namespace marengo {
 namespace amaze {
 
+// Counts for the last update(), for profiling (see the --headless report)
+struct RenderStats {
+    size_t linesDrawn { 0 };
+    size_t linesCulled { 0 };
+    size_t shapesCulled { 0 };
+    size_t staticLines { 0 }; // shown in the static layer, as last changed
+};
+
 class View {
 public:
     View(GameModel& model, IGraphicsAdapter& gm);
-    void update(); // this is called once per game loop iteration
-    void rotateAndDrawShape(const GameShape& shape) const;
+    // This is called once per game loop iteration. "alpha" is how far we are
+    // (0 to 1) from the start of the latest simulation step to the next one.
+    void update(double alpha = 1.0);
+    // Adds the shape's lines (as quads) to the batch which update()
+    // transforms to the screen (rotated around the ship) and draws
+    void rotateAndDrawShape(const GameShape& shape);
     void drawStaticShape(const GameShape& shape) const;
     void playSounds();
     void stopSounds();
+    const RenderStats& renderStats() const;
 
 private:
+    Camera camera() const;
+    // Everything in the Level, i.e. the grid, static and dynamic shapes
+    void drawWorld();
+    // The background grid isn't a GameShape, it's drawn by the graphics
+    // adapter as a single layer
+    void drawGrid();
+    // Sends all static shapes to the graphics adapter, with the inactive ones
+    // hidden. This is only needed for a new Level (or window size).
+    void buildStaticLayer();
+    // Hides or shows the static shapes which have been (de)activated
+    void updateStaticLayer();
+
     GameModel& m_model;
     IGraphicsAdapter& m_graphicsAdapter;
+    // For purely cosmetic effects, so as not to disturb the model's
+    utils::Random m_random;
+    std::vector<LineInstance> m_lines; // for building the static layer
+    // Where each static shape's lines are in the static layer
+    struct StaticShapeLines {
+        const GameShape* shape;
+        size_t first;
+        size_t count;
+        bool shown;
+    };
+    std::vector<StaticShapeLines> m_staticShapeLines;
+    std::vector<LineQuad> m_quads; // reused every frame
+    // Corners of m_quads (four per quad), in world then screen coordinates
+    std::vector<float> m_pointsX;
+    std::vector<float> m_pointsY;
+    cameratransform::TransformFn m_transform { cameratransform::bestTransform() };
+    Camera m_camera {}; // for the current frame
+    double m_alpha { 1.0 }; // for the current frame
+    RenderStats m_renderStats;
+    std::optional<unsigned> m_staticLayerGeneration; // the model's Level generation
+    std::optional<unsigned> m_staticLayerVersion; // its static shapes version
+    bool m_backdropCaptured { false };
+    std::pair<int, int> m_windowSize { 0, 0 }; // as the above were made for
 };
 
 } // namespace amaze